@@ -0,0 +1,398 @@
+
+#include "GL.h"
+#include "Periodic.hpp"
+#include "Spline.hpp"
+#include "ThreadPool.hpp"
+#include "Trajectory.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+/*
+	Accuracy and throughput of the spline builders. Analytic trajectories are sampled into
+	frames wrapped into the box, every builder turns them into weights and the weights are
+	evaluated in the middle of every segment against the analytic curve:
+		sinusoid:	x = c + A sin(2 pi f tau + phi), a few periods per run
+		ballistic:	x = x0 + v tau + g tau^2 / 2
+		pbc:		drift through several boxes plus a small wobble, wraps every few frames
+	Builders: cpu (SplineBuilder::build), cpu compact (SplineBuilder::compact), cpu stream
+	(Spline::Stream, unwraps itself) and, with a gl 4.3 context, gpu and gpu compact
+	(t_shader). Throughput is atoms * steps per second of the build alone, the unwrap is
+	timed separately.
+
+	Every builder has to stay within the max and rms error bounds of tolerance(), and the gpu
+	weights have to match the cpu weights element by element (compare). Any miss is marked
+	FAIL and the exit code is 1, so ctest runs a small size of it.
+
+	The sampled frames also go through the layouts of Trajectory.hpp (frames -> atoms ->
+	tiles -> frames), timed per conversion and checked element by element, the round trip
+	has to be exact.
+
+	usage: mdvis_bench [--atoms=1000,10000,...] [--steps=n] [--threads=n] [--memory=MB] [--gpu=0|1]
+	Run from the build directory like mdvis, the shaders are looked up in ../shader.
+*/
+
+namespace {
+
+	const Vec3 BOX(10.f, 10.f, 10.f);
+
+	//largest difference between gpu and cpu weights, in what a term adds to the position over one segment
+	const float WEIGHT_TOLERANCE = 1e-4f;
+
+	//frames skipped at both ends: the natural end conditions bend the first and last segments
+	const uint EDGE = 4;
+
+	enum class Motion { sinusoid, ballistic, pbc };
+
+	const char* name(Motion _m) {
+		return _m == Motion::sinusoid ? "sinusoid" : _m == Motion::ballistic ? "ballistic" : "pbc";
+	}
+
+	//unwrapped analytic position of coordinate _k of _atom at _tau in [0, 1]
+	float analytic(Motion _m, uint _atom, uint _k, float _tau) {
+		const float seed = float((_atom * 3 + _k) % 97) / 97.f;
+		switch (_m) {
+			case Motion::sinusoid:
+				return 5.f + 2.f * std::sin(6.2831853f * (1.f + 3.f * seed) * _tau + 6.2831853f * seed);
+			case Motion::ballistic:
+				return 2.f + (4.f + 4.f * seed) * _tau - 6.f * _tau * _tau;
+			default:
+				return 1.f + 10.f * seed + (20.f + 20.f * seed) * _tau + 0.3f * std::sin(25.f * _tau);
+		}
+	}
+
+	float wrapped(float _x, float _box) {
+		return _x - _box * std::floor(_x / _box);
+	}
+
+	//frame major, wrapped into the box like a trajectory file
+	std::vector<float> sample(Motion _m, uint _count, uint _steps) {
+		std::vector<float> traj(static_cast<size_t>(_count) * 3 * _steps);
+		const float box[3] = { BOX.x, BOX.y, BOX.z };
+		ThreadPool::get().run(_steps, [&](uint _step, uint) {
+			const float tau = float(_step) / float(_steps);
+			float* frame = traj.data() + static_cast<size_t>(_step) * _count * 3;
+			for (uint a = 0; a < _count; ++a)
+				for (uint k = 0; k < 3; ++k)
+					frame[3 * a + k] = wrapped(analytic(_m, a, k, tau), box[k]);
+		});
+		return traj;
+	}
+
+	struct Error {
+		double max = 0., rms = 0.;
+	};
+
+	/*
+		Distance between the wrapped positions _pos at the middle of the segments [EDGE, steps - EDGE)
+		and the analytic curve, nearest image. _pos as SplineBuilder::evaluate writes it for _atoms atoms.
+	*/
+	Error error(Motion _m, uint _atoms, uint _steps, const std::vector<float>& _pos) {
+		const float box[3] = { BOX.x, BOX.y, BOX.z };
+		Error e;
+		size_t n = 0;
+		for (uint s = EDGE; s + EDGE < _steps; ++s) {
+			const float tau = (float(s) + 0.5f) / float(_steps);
+			const float* p = _pos.data() + static_cast<size_t>(s - EDGE) * _atoms * 3;
+			for (uint a = 0; a < _atoms; ++a) {
+				double d2 = 0.;
+				for (uint k = 0; k < 3; ++k) {
+					float d = p[3 * a + k] - analytic(_m, a, k, tau);
+					d -= box[k] * std::round(d / box[k]);
+					d2 += double(d) * d;
+				}
+				e.max = std::max(e.max, std::sqrt(d2));
+				e.rms += d2;
+				++n;
+			}
+		}
+		e.rms = n ? std::sqrt(e.rms / double(n)) : 0.;
+		return e;
+	}
+
+	/*
+		Error bounds against the analytic curve. Inside, the cubic spline bound 5/384 h^4 max|f''''|
+		holds; the natural end conditions leave an error at the last segments before EDGE that
+		falls with h (slopes measured from 16 to 4096 steps, with a margin). Compact weights add
+		the 16 bit fixed point of a.
+	*/
+	Error tolerance(Motion _m, uint _steps, bool _compact) {
+		const double h = 1. / double(_steps);
+		//max |f''''| of the curves in analytic: A w^4
+		const double fourth = _m == Motion::sinusoid ? 2. * std::pow(6.2831853 * 4., 4.) : _m == Motion::pbc ? 0.3 * std::pow(25., 4.) : 0.;
+		const double interior = 5. / 384. * std::pow(h, 4.) * fourth;
+		const double edge = (_m == Motion::ballistic ? 0.1 : 0.5) * h;
+		const double lsb = _compact ? BOX.x / 65535. : 0.;
+		Error e;
+		e.max = interior + edge + 2. * lsb + 1e-5;
+		e.rms = (interior + edge) / 4. + lsb + 1e-5;
+		return e;
+	}
+
+	/*
+		Element-wise gpu against cpu float weights. Term j is compared by what it adds over one
+		segment, w * t^j, so b, c and d are held to the same length as a. Returns the number of
+		weights off by more than WEIGHT_TOLERANCE, _worst the largest difference.
+	*/
+	size_t compare(const std::vector<float>& _gpu, const std::vector<float>& _cpu, uint _steps, float& _worst) {
+		const float t = 1.f / float(_steps);
+		const float scale[4] = { 1.f, t, t * t, t * t * t };
+		size_t misses = 0;
+		_worst = 0.f;
+		for (size_t i = 0; i < _cpu.size(); ++i) {
+			const float d = std::abs(_gpu[i] - _cpu[i]) * scale[(i % 12) / 3];
+			_worst = std::max(_worst, d);
+			if (!(d <= WEIGHT_TOLERANCE)) ++misses;
+		}
+		return misses;
+	}
+
+	/*
+		Same for compact weights: a may differ by one step of the fixed point (0 and 65535 are
+		the same position), the halves by one ulp on top of WEIGHT_TOLERANCE.
+	*/
+	size_t compare(const std::vector<uint>& _gpu, const std::vector<uint>& _cpu, float& _worst) {
+		size_t misses = 0;
+		_worst = 0.f;
+		for (size_t i = 0; i < _cpu.size(); ++i) {
+			for (uint half = 0; half < 2; ++half) {
+				const uint g = (_gpu[i] >> (16 * half)) & 0xFFFFu;
+				const uint c = (_cpu[i] >> (16 * half)) & 0xFFFFu;
+				//the value index within the atom and segment, a.xyz first
+				const uint v = 2 * static_cast<uint>(i % 6) + half;
+				float d, allowed;
+				if (v < 3) {
+					const uint steps = g > c ? g - c : c - g;
+					d = float(std::min(steps, 65535u - steps)) / 65535.f * BOX[v];
+					allowed = BOX[v] / 65535.f;
+				} else {
+					const float cv = Spline::fromHalf(c);
+					d = std::abs(Spline::fromHalf(g) - cv);
+					allowed = WEIGHT_TOLERANCE + std::abs(cv) * 0x1p-10f;
+				}
+				_worst = std::max(_worst, d);
+				if (!(d <= allowed)) ++misses;
+			}
+		}
+		return misses;
+	}
+
+	std::vector<float> midpoints(uint _steps) {
+		std::vector<float> times;
+		for (uint s = EDGE; s + EDGE < _steps; ++s)
+			times.push_back((float(s) + 0.5f) / float(_steps));
+		return times;
+	}
+
+	template<typename Fn>
+	double seconds(Fn _fn) {
+		const auto start = std::chrono::high_resolution_clock::now();
+		_fn();
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/*
+		Converts the frame major _frames through every layout of a Trajectory and back. After
+		each conversion every element is looked up with Trajectory::index, and the frames that
+		come back have to be bit for bit the ones that went in. One row per conversion.
+	*/
+	bool layouts(uint _count, uint _steps, const std::vector<float>& _frames) {
+		Trajectory store(std::vector<float>(_frames), _count);
+		auto matches = [&]() {
+			const std::vector<float>& d = store.data();
+			for (uint s = 0; s < _steps; ++s)
+				for (uint a = 0; a < _count; ++a)
+					for (uint k = 0; k < 3; ++k)
+						if (d[store.index(s, a, k)] != _frames[(static_cast<size_t>(s) * _count + a) * 3 + k]) return false;
+			return true;
+		};
+
+		bool ok = true;
+		const std::pair<Trajectory::Layout, const char*> steps[] = {
+			{ Trajectory::Layout::atoms, "to atoms" }, { Trajectory::Layout::tiles, "to tiles" }, { Trajectory::Layout::frames, "to frames" } };
+		for (const auto& step : steps) {
+			const double s = seconds([&]() { store.convert(step.first); });
+			const bool same = matches();
+			std::printf("%-10s %9u %6u  %-12s %12s %12s %14.1f  %s\n", "layout", _count, _steps, step.second, "-", "-",
+				double(_count) * _steps / std::max(s, 1e-9) / 1e6, same ? "ok" : "FAIL");
+			ok &= same;
+		}
+		const bool exact = store.release() == _frames;
+		if (!exact)
+			std::printf("%-10s %9u %6u  %-12s round trip changed the frames  FAIL\n", "layout", _count, _steps, "");
+		return ok && exact;
+	}
+
+	//one row, returns whether the error is within _bound
+	bool report(Motion _m, uint _count, uint _steps, const char* _builder, const Error& _e, const Error& _bound, double _s) {
+		const bool ok = _e.max <= _bound.max && _e.rms <= _bound.rms;
+		std::printf("%-10s %9u %6u  %-12s %12.3e %12.3e %14.1f  %s\n", name(_m), _count, _steps, _builder, _e.max, _e.rms,
+			double(_count) * _steps / std::max(_s, 1e-9) / 1e6, ok ? "ok" : "FAIL");
+		if (!ok)
+			std::printf("%-10s %9s %6s  %-12s %12.3e %12.3e  bound\n", "", "", "", "", _bound.max, _bound.rms);
+		return ok;
+	}
+
+	//one row for an element-wise comparison, _worst in the max error column
+	bool reportWeights(const char* _builder, size_t _misses, size_t _total, float _worst) {
+		std::printf("%-10s %9s %6s  %-12s %12.3e %12s %14s  %s\n", "", "", "", _builder, double(_worst), "-", "-", _misses ? "FAIL" : "ok");
+		if (_misses)
+			std::printf("%-10s %9s %6s  %-12s %zu of %zu weights over tolerance\n", "", "", "", "", _misses, _total);
+		return _misses == 0;
+	}
+
+	bool initGL() {
+		if (!glfwInit()) return false;
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "mdvis_bench", nullptr, nullptr);
+		if (!window) return false;
+		glfwMakeContextCurrent(window);
+		return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+	}
+
+	//builds on the gpu from the unwrapped _traj and reads the weights back
+	template<typename T>
+	double buildGPU(uint _count, uint _steps, bool _compact, const std::vector<float>& _traj, std::vector<T>& _out) {
+		GLuint traj, weights;
+		glGenBuffers(1, &traj);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, traj);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, _traj.size() * sizeof(float), _traj.data(), GL_STATIC_DRAW);
+		_out.resize(static_cast<size_t>(_count) * _steps * (_compact ? 6 : 12));
+		glGenBuffers(1, &weights);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, weights);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, _out.size() * sizeof(T), nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glFinish();
+
+		const double s = seconds([&]() { SplineBuilder::buildGPU(_count, _steps, BOX, _compact, traj, weights, true); });
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, weights);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _out.size() * sizeof(T), _out.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glDeleteBuffers(1, &traj);
+		glDeleteBuffers(1, &weights);
+		return s;
+	}
+
+	std::vector<uint> parseList(const std::string& _v) {
+		std::vector<uint> out;
+		std::stringstream ss(_v);
+		std::string item;
+		while (std::getline(ss, item, ','))
+			if (!item.empty()) out.push_back(static_cast<uint>(std::strtoul(item.c_str(), nullptr, 10)));
+		return out;
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+
+	Logger::init();
+
+	std::vector<uint> sizes = { 1000, 10000, 100000, 1000000, 10000000 };
+	uint steps = 0, threads = 0, memory = 4096;
+	bool gpu = true;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg(argv[i]);
+		const size_t eq = arg.find('=');
+		const std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "1" : arg.substr(eq + 1);
+		char* end = nullptr;
+		const unsigned long number = std::strtoul(value.c_str(), &end, 10);
+		const bool numeric = !value.empty() && *end == '\0';
+		if (key == "--atoms") sizes = parseList(value);
+		else if (key == "--steps" && numeric) steps = static_cast<uint>(number);
+		else if (key == "--threads" && numeric) threads = static_cast<uint>(number);
+		else if (key == "--memory" && numeric) memory = static_cast<uint>(number);
+		else if (key == "--gpu") gpu = value != "0";
+		else {
+			Logger::LOG("ERROR:\tInvalid option '" + arg + "'", true);
+			return 1;
+		}
+	}
+
+	ThreadPool::init(threads);
+	if (gpu && !(gpu = initGL()))
+		Logger::LOG("WARNING:\tNo gl 4.3 context, skipping the gpu builders", true);
+
+	std::printf("%u threads, errors over segments [%u, steps - %u), box %.0f\n\n", ThreadPool::get().size(), EDGE, EDGE, BOX.x);
+	std::printf("%-10s %9s %6s  %-12s %12s %12s %14s\n", "motion", "atoms", "steps", "builder", "max error", "rms error", "M atom*step/s");
+
+	size_t failures = 0;
+
+	for (const uint count : sizes) {
+		//enough steps to resolve the motion, fewer for many atoms to bound the memory
+		const uint n = steps ? steps : std::clamp((1u << 25) / std::max(count, 1u), 4u * EDGE, 1024u);
+		//trajectory, unwrapped copy, float and compact weights, evaluated positions. The layouts run before the weights exist
+		const size_t bytes = static_cast<size_t>(count) * n * (3 + 3 + 12 + 6 + 3) * sizeof(float);
+		if (bytes > static_cast<size_t>(memory) << 20) {
+			std::printf("%9u atoms x %u steps needs ~%zu MB, over --memory=%u, skipped\n", count, n, bytes >> 20, memory);
+			continue;
+		}
+		//accuracy is taken over the first atoms, it does not change with the count
+		const uint probe = std::min(count, 4096u);
+		const std::vector<float> times = midpoints(n);
+
+		for (const Motion m : { Motion::sinusoid, Motion::ballistic, Motion::pbc }) {
+			const std::vector<float> raw = sample(m, count, n);
+			if (m == Motion::sinusoid)
+				failures += !layouts(count, n, raw);
+			std::vector<float> traj(raw), weights, pos;
+			std::vector<uint> compact;
+
+			const double unwrap = seconds([&]() { Periodic::unwrap(traj, count, BOX); });
+			std::printf("%-10s %9u %6u  %-12s %12s %12s %14.1f\n", name(m), count, n, "unwrap", "-", "-", double(count) * n / std::max(unwrap, 1e-9) / 1e6);
+
+			const Error bound = tolerance(m, n, false), compactBound = tolerance(m, n, true);
+
+			double s = seconds([&]() { SplineBuilder::build(count, n, traj, weights); });
+			SplineBuilder::evaluate(count, n, BOX, true, weights, times, 0, probe, pos);
+			failures += !report(m, count, n, "cpu", error(m, probe, n, pos), bound, s);
+
+			s = seconds([&]() { SplineBuilder::compact(count, n, BOX, weights, compact); });
+			SplineBuilder::evaluate(count, n, BOX, compact, times, 0, probe, pos);
+			failures += !report(m, count, n, "cpu compact", error(m, probe, n, pos), compactBound, s);
+
+			{
+				std::vector<float> streamed(weights.size());
+				s = seconds([&]() {
+					Spline::Stream stream(count, n, BOX, [&](uint _first, uint _segments, const float* _w) {
+						std::memcpy(streamed.data() + static_cast<size_t>(_first) * count * 12, _w, static_cast<size_t>(_segments) * count * 12 * sizeof(float));
+					});
+					const size_t frame = static_cast<size_t>(count) * 3;
+					for (uint i = 0; i < n; i += 16)
+						stream.push(raw.data() + i * frame, std::min(16u, n - i));
+					stream.finish();
+				});
+				SplineBuilder::evaluate(count, n, BOX, true, streamed, times, 0, probe, pos);
+				failures += !report(m, count, n, "cpu stream", error(m, probe, n, pos), bound, s);
+			}
+
+			if (gpu) {
+				std::vector<float> gpuWeights;
+				s = buildGPU(count, n, false, traj, gpuWeights);
+				SplineBuilder::evaluate(count, n, BOX, true, gpuWeights, times, 0, probe, pos);
+				failures += !report(m, count, n, "gpu", error(m, probe, n, pos), bound, s);
+				float worst;
+				size_t misses = compare(gpuWeights, weights, n, worst);
+				failures += !reportWeights("gpu vs cpu", misses, weights.size(), worst);
+
+				std::vector<uint> gpuCompact;
+				s = buildGPU(count, n, true, traj, gpuCompact);
+				SplineBuilder::evaluate(count, n, BOX, gpuCompact, times, 0, probe, pos);
+				failures += !report(m, count, n, "gpu compact", error(m, probe, n, pos), compactBound, s);
+				misses = compare(gpuCompact, compact, worst);
+				failures += !reportWeights("gpu vs cpu", misses, 2 * compact.size(), worst);
+			}
+		}
+		std::printf("\n");
+	}
+
+	if (gpu) glfwTerminate();
+	if (failures)
+		std::printf("%zu checks over tolerance\n", failures);
+	return failures ? 1 : 0;
+}
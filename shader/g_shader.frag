@@ -1,11 +1,17 @@
 
 #version 430 core
 
+#ifdef COMPACT_GBUFFER
+//position comes back from the depth buffer, the tangents are not needed by any pass
+layout(location = 0) out vec2 g_nrm;
+layout(location = 1) out vec4 g_col;
+#else
 layout(location = 0) out vec4 g_pos;
 layout(location = 1) out vec4 g_nrm;
 layout(location = 2) out vec4 g_t;
 layout(location = 3) out vec4 g_bt;
 layout(location = 4) out vec4 g_col;
+#endif
 
 in vec4 vertexColor; 
 
@@ -13,12 +19,34 @@ in vec3 pos;
 in vec3 N;
 in vec3 X; //tangent
 in vec3 Y; //bitangent
+#ifdef ATOM_AO
+in float occlusion;
+#endif
+
+#ifdef COMPACT_GBUFFER
+//octahedral normal, the unit sphere folded onto [-1, 1]^2
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return n.xy;
+}
+#endif
 
 void main() {
     //float d = 2.0 - gl_FragCoord.z - 1.f;
+#ifdef COMPACT_GBUFFER
+    g_nrm = octEncode(normalize(N));
+#else
     g_pos = vec4(pos, 0.f);
     g_nrm = vec4(N, 0.f);
     g_t = vec4(X, 0.f);
     g_bt = vec4(Y, 0.f);
+#endif
+#ifdef ATOM_AO
+    //the lighting pass reads the occlusion of the atom from the albedo alpha
+    g_col = vec4(vertexColor.rgb, occlusion);
+#else
     g_col = vertexColor;
+#endif
 }
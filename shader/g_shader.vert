@@ -1,12 +1,17 @@
 #version 430 core
 
-layout (location = 5) in vec3 position;
+layout (location = 4) in vec3 vertex; //unit sphere, shared by all atoms
+layout (location = 5) in vec3 centre; //per instance, written by the compute pass
 layout (location = 6) in vec3 nrm;
 layout (location = 7) in vec3 t;
 layout (location = 8) in vec3 bt;
+#ifdef ATOM_AO
+layout (location = 10) in float ao; //per instance, written by the ao pass
+#endif
 
 layout (location = 9) uniform vec4 col;
 layout (location = 10) uniform mat4 cam;
+layout (location = 11) uniform float radius;
 
 
 out vec3 pos;
@@ -14,12 +19,19 @@ out vec4 vertexColor;
 out vec3 N;
 out vec3 X;
 out vec3 Y;
+#ifdef ATOM_AO
+out float occlusion;
+#endif
 
 void main() {
+    const vec3 position = centre + vertex * radius;
     gl_Position = cam * vec4(position, 1.f);
-    pos = vec4(position, 1.f).xyz;
+    pos = position;
     N = nrm;
     X = t;
     Y = bt;
     vertexColor = col;
+#ifdef ATOM_AO
+    occlusion = ao;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#version 430 core
+
+#ifdef COMPACT_GBUFFER
+//position comes back from the depth buffer, the tangents are not needed by any pass
+layout(location = 0) out vec2 g_nrm;
+layout(location = 1) out vec4 g_col;
+#else
+layout(location = 0) out vec4 g_pos;
+layout(location = 1) out vec4 g_nrm;
+layout(location = 2) out vec4 g_t;
+layout(location = 3) out vec4 g_bt;
+layout(location = 4) out vec4 g_col;
+#endif
+
+layout (location = 11) uniform float radius;
+layout (location = 12) uniform mat4 view;
+layout (location = 13) uniform mat4 projection;
+
+in vec3 ray;
+flat in vec3 viewCentre;
+flat in vec3 worldCentre;
+flat in vec4 vertexColor;
+#ifdef ATOM_AO
+flat in float occlusion;
+#endif
+
+#ifdef COMPACT_GBUFFER
+//octahedral normal, the unit sphere folded onto [-1, 1]^2
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return n.xy;
+}
+#endif
+
+/*
+	Ray cast sphere impostor. Writes the same g-buffer as g_shader.frag, with the exact
+	surface instead of the icosphere: world position, normal, the tangent frame the icosphere
+	table uses and the depth of the hit.
+*/
+void main() {
+    const vec3 D = normalize(ray);
+    const float b = dot(D, viewCentre);
+    const float h = b * b - dot(viewCentre, viewCentre) + radius * radius;
+    if (h < 0.f)
+        discard;
+    const vec3 hit = (b - sqrt(h)) * D;
+
+    //the view matrix is rigid, its transpose takes the normal back to world space
+    const vec3 N = transpose(mat3(view)) * ((hit - viewCentre) / radius);
+
+#ifndef COMPACT_GBUFFER
+    //cross(n, UVY), cross(n, UVX) at the poles, as in Icosphere::build
+    vec3 T = vec3(-N.z, 0.f, N.x);
+    if (dot(T, T) < 1e-12f)
+        T = vec3(0.f, N.z, -N.y);
+    T = normalize(T);
+    const vec3 BT = normalize(cross(N, T));
+#endif
+
+    const vec4 clip = projection * vec4(hit, 1.f);
+    gl_FragDepth = 0.5f * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.far + gl_DepthRange.near);
+
+#ifdef COMPACT_GBUFFER
+    g_nrm = octEncode(N);
+#else
+    g_pos = vec4(worldCentre + N * radius, 0.f);
+    g_nrm = vec4(N, 0.f);
+    g_t = vec4(T, 0.f);
+    g_bt = vec4(BT, 0.f);
+#endif
+#ifdef ATOM_AO
+    g_col = vec4(vertexColor.rgb, occlusion);
+#else
+    g_col = vertexColor;
+#endif
+}
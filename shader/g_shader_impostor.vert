@@ -0,0 +1,47 @@
+#version 430 core
+
+layout (location = 5) in vec3 centre; //per instance, written by the compute pass
+#ifdef ATOM_AO
+layout (location = 10) in float ao; //per instance, written by the ao pass
+#endif
+
+layout (location = 9) uniform vec4 col;
+layout (location = 11) uniform float radius;
+layout (location = 12) uniform mat4 view;
+layout (location = 13) uniform mat4 projection;
+
+out vec3 ray; //view space point on the quad, the eye sits in the origin
+flat out vec3 viewCentre;
+flat out vec3 worldCentre;
+flat out vec4 vertexColor;
+#ifdef ATOM_AO
+flat out float occlusion;
+#endif
+
+/*
+	One quad per atom as a triangle strip of 4 vertices (gl_VertexID 0..3). It faces the eye
+	and is scaled to the cone from the eye that touches the sphere, so it covers the silhouette
+	exactly under perspective. The fragment shader intersects the sphere along ray.
+*/
+void main() {
+    const vec3 c = (view * vec4(centre, 1.f)).xyz;
+    const float d = length(c);
+
+    const vec3 dir = c / d;
+    const vec3 up = abs(dir.y) < 0.99f ? vec3(0.f, 1.f, 0.f) : vec3(1.f, 0.f, 0.f);
+    const vec3 right = normalize(cross(dir, up));
+    const vec3 top = cross(right, dir);
+
+    //half size of the silhouette in the plane through the centre. The eye inside the sphere gets an empty quad
+    const float size = d > radius ? radius * d / sqrt(d * d - radius * radius) : 0.f;
+    const vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.f - 1.f;
+
+    ray = c + (corner.x * right + corner.y * top) * size;
+    viewCentre = c;
+    worldCentre = centre;
+    vertexColor = col;
+#ifdef ATOM_AO
+    occlusion = ao;
+#endif
+    gl_Position = projection * vec4(ray, 1.f);
+}
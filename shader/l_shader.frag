@@ -6,10 +6,15 @@ const float PI =  3.14159265358979323846;
 //out vec4 fragColor;
  out vec4 fragColor;
   
+#ifdef COMPACT_GBUFFER
+layout (location = 2) uniform sampler2D g_depth;
+layout (location = 3) uniform sampler2D g_nrm;
+#else
 layout (location = 2) uniform sampler2D g_pos;
 layout (location = 3) uniform sampler2D g_nrm;
 layout (location = 4) uniform sampler2D g_t;
 layout (location = 5) uniform sampler2D g_bt; 
+#endif
 layout (location = 6) uniform sampler2D g_col;
 layout (location = 7) uniform sampler2D g_ssao;
 
@@ -21,13 +26,39 @@ layout (location = 10) uniform float intensity = 0.5f;
 
 layout(location = 12) uniform float lights[4*6];
 
+#ifdef COMPACT_GBUFFER
+//after the 24 locations of lights
+layout(location = 40) uniform mat4 invViewProj;
+#endif
+
 in vec2 uvs;
 
+#ifdef COMPACT_GBUFFER
+//inverse of octEncode in the geometry pass
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return normalize(n);
+}
+
+//position of the depth sample at _uv, in the space _inverse takes clip space to
+vec3 unproject(mat4 _inverse, vec2 _uv, float _depth) {
+    const vec4 p = _inverse * vec4(vec3(_uv, _depth) * 2.f - 1.f, 1.f);
+    return p.xyz / p.w;
+}
+#endif
+
 void main() {
 
+#ifdef COMPACT_GBUFFER
+    vec3 pos = unproject(invViewProj, uvs, texture(g_depth, uvs).r);
+    vec3 N = octDecode(texture(g_nrm, uvs).xy);
+#else
     vec3 pos = texture(g_pos, uvs).xyz;
-    vec3 V = -normalize(pos - camPos.xyz);
     vec3 N = texture(g_nrm, uvs).xyz;
+#endif
+    vec3 V = -normalize(pos - camPos.xyz);
     vec3 albedo = texture(g_col, uvs).rgb;
     float ao = texture(g_ssao, uvs).x;// * 2 - 1;
 
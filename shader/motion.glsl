@@ -0,0 +1,15 @@
+/*
+	Motion channels of the compute shaders, injected by the host after the defines when motion
+	is on (see load()). Not a shader program of its own.
+*/
+
+//velocity per time step and acceleration per time step squared, as halves: v.xy, (v.z, a.x), a.yz
+layout(std430, binding = 5) writeonly buffer motion {
+	uint m_data[]; //3 per atom
+};
+
+void storeMotion(uint _atom, vec3 _v, vec3 _a) {
+	m_data[3 * _atom] = packHalf2x16(_v.xy);
+	m_data[3 * _atom + 1] = packHalf2x16(vec2(_v.z, _a.x));
+	m_data[3 * _atom + 2] = packHalf2x16(_a.yz);
+}
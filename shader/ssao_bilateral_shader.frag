@@ -0,0 +1,37 @@
+#version 430 core
+
+out float fragColor;
+
+layout (location = 2) uniform sampler2D ssaoInput;
+layout (location = 3) uniform sampler2D s_depth;
+layout (location = 4) uniform ivec2 direction;
+
+const float BACKGROUND = -1e30f;
+//depth difference, relative to the distance, at which a neighbour weighs 1/e
+const float DEPTH_SIGMA = 0.02f;
+//gaussian with sigma 2, normalized by the sum of the weights taken
+const float WEIGHTS[5] = float[](1.f, 0.8825f, 0.6065f, 0.3247f, 0.1353f);
+
+/*
+	One direction of the separable depth aware blur of the reduced resolution SSAO. Taps on
+	another surface get no weight, so the occlusion does not bleed over silhouettes.
+*/
+void main() {
+    const ivec2 texel = ivec2(gl_FragCoord.xy);
+    const ivec2 size = textureSize(ssaoInput, 0);
+    const float z = texelFetch(s_depth, texel, 0).r;
+    if (z <= BACKGROUND) {
+        fragColor = 1.f;
+        return;
+    }
+
+    float sum = 0.f;
+    float weights = 0.f;
+    for (int i = -4; i <= 4; ++i) {
+        const ivec2 t = clamp(texel + i * direction, ivec2(0), size - 1);
+        const float w = WEIGHTS[abs(i)] * exp(-abs(texelFetch(s_depth, t, 0).r - z) / (DEPTH_SIGMA * -z));
+        sum += w * texelFetch(ssaoInput, t, 0).r;
+        weights += w;
+    }
+    fragColor = sum / weights;
+}
@@ -0,0 +1,26 @@
+#version 430 core
+
+out float viewZ;
+
+layout (location = 2) uniform sampler2D g_depth;
+layout (location = 14) uniform mat4 invProjection;
+
+//view z of the texels without atoms, far enough to never occlude or pass a depth weight
+const float BACKGROUND = -1e30f;
+
+/*
+	Downsamples the depth for the reduced resolution SSAO: one texel of every SCALE x SCALE
+	block, the one whose normal the SSAO pass reads, stored as linear view z so the kernel
+	samples, the blur and the upsample compare depths without unprojecting again.
+*/
+void main() {
+    const ivec2 texel = ivec2(gl_FragCoord.xy) * SCALE;
+    const float depth = texelFetch(g_depth, texel, 0).r;
+    if (depth == 1.f) {
+        viewZ = BACKGROUND;
+        return;
+    }
+    const vec2 uv = (vec2(texel) + 0.5f) / vec2(textureSize(g_depth, 0));
+    const vec4 p = invProjection * vec4(vec3(uv, depth) * 2.f - 1.f, 1.f);
+    viewZ = p.z / p.w;
+}
@@ -5,11 +5,20 @@ const float PI =  3.14159265358979323846;
 
 out float fragColor;
   
+#ifdef COMPACT_GBUFFER
+layout (location = 2) uniform sampler2D g_depth;
+layout (location = 3) uniform sampler2D g_nrm;
+#else
 layout (location = 2) uniform sampler2D g_pos;
 layout (location = 3) uniform sampler2D g_nrm;
 layout (location = 4) uniform sampler2D g_t;
 layout (location = 5) uniform sampler2D g_bt;
+#endif
 
+#ifdef SCALE
+//view z at the reduced resolution, see ssao_depth_shader
+layout (location = 6) uniform sampler2D s_depth;
+#endif
 layout (location = 7) uniform sampler2D g_noise;
 
 layout(location = 8) uniform mat4 projection;
@@ -17,7 +26,14 @@ layout(location = 9) uniform vec2 bounds;
 layout(location = 10) uniform float radius = 1.f;
 layout(location = 11) uniform float bias = 0.025;
 layout (location = 12) uniform mat4 view;
+#ifdef KERNEL_SIZE
+const int kernelSize = KERNEL_SIZE;
+#else
 layout (location = 13) uniform int kernelSize = 64;
+#endif
+#if defined(COMPACT_GBUFFER) || defined(SCALE)
+layout (location = 14) uniform mat4 invProjection;
+#endif
 
 layout(std430, binding = 1) buffer sb {
 	float samples[];
@@ -25,12 +41,69 @@ layout(std430, binding = 1) buffer sb {
 
 in vec2 uvs;
 
+const float BACKGROUND = -1e30f;
+
+#ifdef COMPACT_GBUFFER
+//inverse of octEncode in the geometry pass
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return normalize(n);
+}
+#endif
+
+#if defined(COMPACT_GBUFFER) || defined(SCALE)
+//position of the depth sample at _uv, in the space _inverse takes clip space to
+vec3 unproject(mat4 _inverse, vec2 _uv, float _depth) {
+    const vec4 p = _inverse * vec4(vec3(_uv, _depth) * 2.f - 1.f, 1.f);
+    return p.xyz / p.w;
+}
+#endif
+
+//view space depth of the g-buffer texel at _uv
+float viewDepth(vec2 _uv) {
+#if defined(SCALE)
+    return texture(s_depth, _uv).r;
+#elif defined(COMPACT_GBUFFER)
+    return unproject(invProjection, _uv, texture(g_depth, _uv).r).z;
+#else
+    return (view * texture(g_pos, _uv)).z;
+#endif
+}
+
 void main() {
 
     const vec2 noiseScale = bounds / 4.f;
 
-    const vec3 pos = vec3((view*texture(g_pos, uvs)).xyz);
-    const vec3 N = texture(g_nrm, uvs).xyz;   
+#if defined(SCALE)
+    //the window texel this one was downsampled from, the position lies on the ray through it
+    const ivec2 texel = ivec2(gl_FragCoord.xy) * SCALE;
+    const float z = texelFetch(s_depth, ivec2(gl_FragCoord.xy), 0).r;
+    if (z <= BACKGROUND) {
+        fragColor = 1.f;
+        return;
+    }
+    const vec3 ray = unproject(invProjection, (vec2(texel) + 0.5f) / vec2(textureSize(g_nrm, 0)), 0.f);
+    const vec3 pos = ray * (z / ray.z);
+#ifdef COMPACT_GBUFFER
+    const vec3 N = octDecode(texelFetch(g_nrm, texel, 0).xy);
+#else
+    const vec3 N = texelFetch(g_nrm, texel, 0).xyz;
+#endif
+#elif defined(COMPACT_GBUFFER)
+    //no stencil on this target when the depth is sampled, the background is skipped here
+    const float depth = texture(g_depth, uvs).r;
+    if (depth == 1.f) {
+        fragColor = 1.f;
+        return;
+    }
+    const vec3 pos = unproject(invProjection, uvs, depth);
+    const vec3 N = octDecode(texture(g_nrm, uvs).xy);
+#else
+    const vec3 pos = (view * texture(g_pos, uvs)).xyz;
+    const vec3 N = texture(g_nrm, uvs).xyz;
+#endif
     const vec3 rand = normalize(texture(g_noise, uvs * noiseScale).xyz);
 
     const vec3 T = normalize(rand - N * dot(rand, N));
@@ -50,7 +123,7 @@ void main() {
         offset.xyz = offset.xyz * 0.5f + 0.5f; // transform to range 0.0 - 1.0
         
         // get sample depth
-        float sampleDepth = (view*texture(g_pos, offset.xy)).z; // get depth value of kernel sample
+        float sampleDepth = viewDepth(offset.xy); // get depth value of kernel sample
         
         // range check & accumulate
         float rangeCheck = smoothstep(0.0, 1.0, radius / abs(pos.z - sampleDepth));
@@ -0,0 +1,52 @@
+#version 430 core
+
+//accumulated occlusion, distance to the camera and frames accumulated
+out vec3 history;
+
+layout (location = 2) uniform sampler2D s_ssao;
+layout (location = 3) uniform sampler2D s_previous;
+layout (location = 4) uniform sampler2D g_depth;
+layout (location = 5) uniform mat4 invViewProj;
+layout (location = 6) uniform mat4 viewProj;
+layout (location = 7) uniform mat4 prevViewProj;
+
+//distance difference, relative to the distance, above which the history saw another surface
+const float DEPTH_TOLERANCE = 0.01f;
+//the history is an average over at most this many frames
+const float MAX_FRAMES = 16.f;
+
+/*
+	Blends this frame's SSAO into the history of the last one. The point seen by the pixel is
+	taken back to the screen of last frame; if the distance stored there differs from the
+	one it had then, the camera or the atoms moved and the pixel starts over.
+*/
+void main() {
+    const ivec2 texel = ivec2(gl_FragCoord.xy);
+    const ivec2 window = texel * SCALE;
+    const float depth = texelFetch(g_depth, window, 0).r;
+    const float ao = texelFetch(s_ssao, texel, 0).r;
+    if (depth == 1.f) {
+        history = vec3(1.f, 0.f, 0.f);
+        return;
+    }
+    const vec2 uv = (vec2(window) + 0.5f) / vec2(textureSize(g_depth, 0));
+    vec4 world = invViewProj * vec4(vec3(uv, depth) * 2.f - 1.f, 1.f);
+    world /= world.w;
+
+    //clip w is the distance along the view direction
+    const vec4 prev = prevViewProj * world;
+    float accumulated = 0.f;
+    float frames = 0.f;
+    if (prev.w > 0.f) {
+        const vec2 prevUV = prev.xy / prev.w * 0.5f + 0.5f;
+        if (all(greaterThanEqual(prevUV, vec2(0.f))) && all(lessThan(prevUV, vec2(1.f)))) {
+            const vec3 last = texelFetch(s_previous, ivec2(prevUV * vec2(textureSize(s_previous, 0))), 0).xyz;
+            if (abs(last.y - prev.w) <= DEPTH_TOLERANCE * prev.w) {
+                accumulated = last.x;
+                frames = last.z;
+            }
+        }
+    }
+    frames = min(frames + 1.f, MAX_FRAMES);
+    history = vec3(mix(accumulated, ao, 1.f / frames), (viewProj * world).w, frames);
+}
@@ -0,0 +1,55 @@
+#version 430 core
+
+out float fragColor;
+
+layout (location = 2) uniform sampler2D ssaoInput;
+layout (location = 3) uniform sampler2D s_depth;
+layout (location = 4) uniform sampler2D g_depth;
+layout (location = 14) uniform mat4 invProjection;
+
+//depth difference, relative to the distance, at which a neighbour weighs 1/e
+const float DEPTH_SIGMA = 0.02f;
+
+/*
+	Brings the blurred reduced resolution SSAO back to the window. The four low resolution
+	texels around a pixel are weighted bilinearly and by how close their depth is to the
+	pixel's own; if none lies on its surface the closest in depth is taken.
+*/
+void main() {
+    const ivec2 texel = ivec2(gl_FragCoord.xy);
+    const float depth = texelFetch(g_depth, texel, 0).r;
+    if (depth == 1.f) {
+        fragColor = 1.f;
+        return;
+    }
+    const vec2 uv = (vec2(texel) + 0.5f) / vec2(textureSize(g_depth, 0));
+    const vec4 p = invProjection * vec4(vec3(uv, depth) * 2.f - 1.f, 1.f);
+    const float z = p.z / p.w;
+
+    //low resolution texel i was taken from the pixel i * SCALE
+    const vec2 low = vec2(texel) / float(SCALE);
+    const ivec2 base = ivec2(floor(low));
+    const vec2 f = fract(low);
+    const ivec2 size = textureSize(s_depth, 0);
+
+    float sum = 0.f;
+    float weights = 0.f;
+    float nearest = 1.f;
+    float closest = 1e38f;
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            const ivec2 t = min(base + ivec2(i, j), size - 1);
+            const float bilinear = (i == 0 ? 1.f - f.x : f.x) * (j == 0 ? 1.f - f.y : f.y);
+            const float dz = abs(texelFetch(s_depth, t, 0).r - z);
+            const float ao = texelFetch(ssaoInput, t, 0).r;
+            const float w = bilinear * exp(-dz / (DEPTH_SIGMA * -z));
+            sum += w * ao;
+            weights += w;
+            if (dz < closest) {
+                closest = dz;
+                nearest = ao;
+            }
+        }
+    }
+    fragColor = weights > 1e-4f ? sum / weights : nearest;
+}
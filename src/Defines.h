@@ -26,6 +26,7 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <unordered_map>
@@ -35,8 +36,16 @@
 
 #define GLM_FORCE_RADIANS
 
+#define MDVIS_VERSION "0.3a"
+
 // -------------------- Configuration --------------------
 
+/*
+	The values below are the defaults of Config (see GL.h). Every one of them can be
+	overridden at startup without recompiling, from mdvis.cfg next to the executable or
+	with --key=value flags (mdvis --help lists them).
+*/
+
 /*
 	Change window resolution here.
 */
@@ -54,6 +63,10 @@
 	0 - no interpolation
 	1 - linear interpoltation
 	2 - cubic spline interpolation
+	3 - Catmull-Rom, cubic through the 4 surrounding frames. No spline weights and no
+		precomputation, a fraction of the memory of 2
+	The interpolation at startup, the 'i' key switches while running. The weights of 2 are
+	built on first use when another one was chosen here.
 	Default:		2
 */
 #define INTERPOLATION_TYPE 2
@@ -73,14 +86,78 @@
 */
 #define COMPUTE_SPLINE_ON_GPU 1
 
+/*
+	Reads the gpu spline back after it was built and compares it to the cpu builder. The
+	largest deviation in the middle of a segment gets logged. Slow, for debugging.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define VALIDATE_GPU_SPLINE 0
+
+/*
+	Stores the spline weights in half the memory: positions as 16 bit fixed point within the
+	box, the higher terms as half floats. Needs ENFORCE_CYCLIC_BOUNDARIES, since the positions
+	are stored wrapped into the box. The largest deviation from the float weights is logged.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define COMPACT_SPLINE 0
+
+/*
+	Lets the compute pass also write the velocity (per time step) and acceleration (per time
+	step squared) of every atom into a side buffer, 3 uints of half floats per atom. Taken
+	from the interpolation itself: the spline or Catmull-Rom derivatives, the frame
+	difference for linear and zero without interpolation.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define MOTION_CHANNELS 0
+
 /*
 	Defines how many times the icosahedron gets subdivided. More subdivison means smoother surface
-	but more vertices to draw. High impact on performance.
-	Valid range: [0,n)
+	but more vertices to draw. High impact on performance. Levels up to 3 are precomputed at compile time.
+	Valid range: [0,5]
 	Default and recommended: 2
 */
 #define SPHERE_SUBDIVISIONS 2
 
+/*
+	Draws every atom as one camera facing quad instead of an icosphere. The fragment shader
+	intersects the exact sphere and writes its depth, normal and position into the g-buffer,
+	so lighting and SSAO see a perfect sphere at any zoom for 4 vertices per atom.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define SPHERE_IMPOSTORS 0
+
+/*
+	Culls the atoms outside the view frustum on the gpu every frame and draws every visible
+	atom with the coarsest sphere level whose edges stay below a few pixels on screen. The
+	draws are indirect, the cpu never reads the visible counts back.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define GPU_CULLING 0
+
+/*
+	Adds two phase occlusion culling to GPU_CULLING (and turns it on). The atoms visible last
+	frame are drawn first, the rest is tested against a depth pyramid of that first draw and
+	only the newly visible ones are drawn. Pays off in dense systems where most atoms hide
+	behind the front layers.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define OCCLUSION_CULLING 0
+
+/*
+	Shrinks the g-buffer to depth, an octahedral normal in RG16 and the albedo in RGBA8. The
+	lighting and SSAO passes rebuild the position from the depth, the tangent targets are
+	dropped. 12 instead of 34 bytes per pixel, for the bandwidth bound high resolutions.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define COMPACT_GBUFFER 0
+
 /*
 	Toggles the axis widget.
 	Valid values:	0, 1
@@ -112,6 +189,72 @@
 #define SSAO_RADIUS 1.f
 #define SSAO_BIAS 0.025f
 
+/*
+	Computes the SSAO at 1/SSAO_SCALE of the window size per axis from a downsampled depth.
+	A separable depth aware blur and a depth aware upsample follow, so the silhouettes of
+	the atoms stay sharp. 2 costs about a quarter of the full resolution pass.
+	Valid values:	1, 2, 4
+	Default:		1
+*/
+#define SSAO_SCALE 1
+
+/*
+	Accumulates the SSAO over the frames. Kernel and noise are drawn anew every frame, the
+	result is blended into a history reprojected with the camera of the last frame; pixels
+	whose depth does not match what the history saw there start over. At most
+	SSAO_TEMPORAL_KERNEL samples are taken per frame.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define SSAO_TEMPORAL 0
+#define SSAO_TEMPORAL_KERNEL 16
+
+/*
+	Object space ambient occlusion instead of SSAO: every frame the atoms are sorted into a
+	uniform grid on the gpu and each one counts the neighbours within ATOM_AO_RADIUS, closer
+	ones weighing more. The value is drawn with the atom and darkens its ambient light. Costs
+	per atom, not per pixel, and does not change with the view. Turns SSAO off.
+	Valid values:	0, 1
+	Default:		0
+*/
+#define ATOM_AO 0
+#define ATOM_AO_RADIUS 0.25f
+
+/*
+	Measures every loading stage (parse, spline, uploads, shader compile, framebuffers) and
+	the frames spent waiting for the loader. The report is written as json once loading finished.
+	Valid values:	0, 1
+	Default:		1
+*/
+#define PROFILE_STARTUP 1
+#define PROFILE_REPORT "mdvis_profile.json"
+
+/*
+	While loading, the render thread runs queued GL tasks for up to TASK_BUDGET_MS per frame.
+	Buffer uploads are split into slices of UPLOAD_SLICE_MB so a single task stays short.
+	Raising the budget loads faster, lowering it keeps the window responsive.
+	Default:		4.f, 16
+*/
+#define TASK_BUDGET_MS 4.f
+#define UPLOAD_SLICE_MB 16
+
+/*
+	Memory budgets in MB. Before the buffers get allocated MdVis estimates what the trajectory
+	needs and, if it does not fit, falls back to Catmull-Rom interpolation and finally skips
+	time steps. 0 means unlimited for the cpu; for the gpu it
+	means the free memory the driver reports (NVX/ ATI meminfo), unlimited if it reports nothing.
+	Default:		0, 0
+*/
+#define MEMORY_BUDGET_CPU_MB 0
+#define MEMORY_BUDGET_GPU_MB 0
+
+/*
+	Threads used for the cpu work while loading (pbc unwrap, spline build), including the
+	loader thread itself. 0 uses one thread per hardware thread.
+	Default:		0
+*/
+#define CPU_THREADS 0
+
 #define GL_DEBUG 0
 
 /*
@@ -2,6 +2,7 @@
 #include "GL.h"
 
 #include "Spline.hpp"
+#include "ThreadPool.hpp"
 
 Logger* Logger::instance = new Logger();
 
@@ -21,6 +22,238 @@ Logger* Logger::get() {
 	return instance;
 }
 
+Profiler* Profiler::instance = new Profiler();
+
+void Profiler::init() {
+	get()->start = std::chrono::high_resolution_clock::now();
+}
+
+void Profiler::record(const std::string& _name, double _ms, size_t _bytes) {
+	Profiler* p = get();
+	std::lock_guard<std::mutex> lock(p->mutex);
+	auto it = std::find_if(p->stages.begin(), p->stages.end(), [&](const Stage& _s) { return _s.name == _name; });
+	if (it == p->stages.end()) {
+		p->stages.push_back({ _name });
+		it = p->stages.end() - 1;
+	}
+	it->calls++;
+	it->ms += _ms;
+	it->bytes += _bytes;
+}
+
+void Profiler::idleFrame(double _ms) {
+	Profiler* p = get();
+	std::lock_guard<std::mutex> lock(p->mutex);
+	p->idleFrames++;
+	p->idleMs += _ms;
+}
+
+bool Profiler::writeReport(const std::string& _path, const std::string& _traj, uint _atoms, uint _steps) {
+	Profiler* p = get();
+	std::lock_guard<std::mutex> lock(p->mutex);
+	const std::chrono::duration<double, std::milli> total = std::chrono::high_resolution_clock::now() - p->start;
+
+	std::ofstream out(_path);
+	if (!out.good()) {
+		Logger::LOG("ERROR:\tCan't write profile report to " + _path, true);
+		return false;
+	}
+
+	std::string traj;
+	for (char c : _traj) {
+		if (c == '\\' || c == '"') traj += '\\';
+		traj += c;
+	}
+
+	out << "{\n";
+	out << "\t\"version\": \"" << MDVIS_VERSION << "\",\n";
+	out << "\t\"trajectory\": \"" << traj << "\",\n";
+	out << "\t\"atoms\": " << _atoms << ",\n";
+	out << "\t\"steps\": " << _steps << ",\n";
+	out << "\t\"total_ms\": " << total.count() << ",\n";
+	out << "\t\"idle_frames\": " << p->idleFrames << ",\n";
+	out << "\t\"idle_ms\": " << p->idleMs << ",\n";
+	out << "\t\"stages\": [\n";
+	for (size_t i = 0; i < p->stages.size(); ++i) {
+		const Stage& st = p->stages[i];
+		const double mbs = st.ms > 0. ? (st.bytes / (1024. * 1024.)) / (st.ms / 1000.) : 0.;
+		out << "\t\t{ \"name\": \"" << st.name << "\", \"calls\": " << st.calls << ", \"wall_ms\": " << st.ms
+			<< ", \"bytes\": " << st.bytes << ", \"throughput_mb_s\": " << mbs << " }" << (i + 1 < p->stages.size() ? ",\n" : "\n");
+	}
+	out << "\t],\n";
+	out << "\t\"cpu_peak_bytes\": " << Memory::peakUsage(Memory::CPU) << ",\n";
+	out << "\t\"gpu_peak_bytes\": " << Memory::peakUsage(Memory::GPU) << ",\n";
+	out << "\t\"memory\": ";
+	Memory::writeJson(out, "\t");
+	out << "\n}\n";
+
+	Logger::LOG("LOG:\tStartup profile [ms] (" + _path + "):", true);
+	for (const Stage& st : p->stages)
+		Logger::LOG("\t -> " + st.name + ": " + std::to_string(st.ms) + " (" + std::to_string(st.bytes / 1024) + " KiB)", false);
+	Logger::LOG("\t -> idle frames: " + std::to_string(p->idleFrames) + " (" + std::to_string(p->idleMs) + ")\n", false);
+
+	return true;
+}
+
+Profiler* Profiler::get() {
+	return instance;
+}
+
+Memory* Memory::instance = new Memory();
+
+void Memory::alloc(Pool _pool, const std::string& _name, size_t _bytes) {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	std::vector<Category>& cats = m->categories[_pool];
+	auto it = std::find_if(cats.begin(), cats.end(), [&](const Category& _c) { return _c.name == _name; });
+	if (it == cats.end()) {
+		cats.push_back({ _name });
+		it = cats.end() - 1;
+	}
+	it->bytes += _bytes;
+	it->peak = std::max(it->peak, it->bytes);
+	m->total[_pool] += _bytes;
+	m->peak[_pool] = std::max(m->peak[_pool], m->total[_pool]);
+}
+
+void Memory::release(Pool _pool, const std::string& _name, size_t _bytes) {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	std::vector<Category>& cats = m->categories[_pool];
+	auto it = std::find_if(cats.begin(), cats.end(), [&](const Category& _c) { return _c.name == _name; });
+	if (it == cats.end()) return;
+	const size_t b = std::min(_bytes, it->bytes);
+	it->bytes -= b;
+	m->total[_pool] -= b;
+}
+
+size_t Memory::used(Pool _pool) {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	return m->total[_pool];
+}
+
+size_t Memory::peakUsage(Pool _pool) {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	return m->peak[_pool];
+}
+
+Memory::Footprint Memory::estimate(const Config& _config, uint _atoms, uint _steps, uint _stride, int _width, int _height) {
+	const size_t A = _atoms;
+	const size_t T = _stride > 1 && _steps > 2 ? (_steps - 2) / _stride + 2 : _steps;
+	const size_t V = Icosphere::vertexCount(_config.sphereSubdivisions);
+	const size_t I = 3 * Icosphere::triangleCount(_config.sphereSubdivisions);
+	const size_t F = sizeof(float);
+	const bool spline = _config.interpolation == 2 && T > 1;
+
+	Footprint f;
+	//trajectory and spline weights
+	f.cpu += 3 * A * T * F;
+	//compact weights are 6 uints, built from the float weights on the cpu
+	const size_t W = _config.compactSpline ? 6 : 12;
+	if (spline && !_config.splineOnGPU) f.cpu += (12 + (_config.compactSpline ? 6 : 0)) * A * T * F;
+
+	//same buffers on the gpu plus one shared sphere mesh, the centres written every frame and the screen targets
+	f.gpu += 3 * A * T * F;
+	if (spline) f.gpu += (W + (_config.splineOnGPU ? 3 : 0)) * A * T * F;
+	f.gpu += 3 * A * F;
+	if (_config.motion) f.gpu += 3 * A * sizeof(uint);
+	//visible centres, one list per LOD and phase, the visibility of last frame
+	if (_config.culling) f.gpu += 3 * A * F * (_config.impostors ? 1 : _config.sphereSubdivisions + 1) * (_config.occlusion ? 2 : 1);
+	if (_config.occlusion) f.gpu += A * sizeof(uint);
+	f.gpu += (3 + Icosphere::AUXVERTEXSIZE) * V * F + I * sizeof(uint);
+	const size_t pixels = static_cast<size_t>(_width) * _height;
+	//5 RGB16F targets + depth stencil, or RG16 normal + RGBA8 albedo + depth stencil
+	f.gpu += pixels * (_config.compactGBuffer ? 4 + 4 + 4 : 5 * 6 + 4 + (_config.atomAO ? 2 : 0));
+	//depth pyramid, a third on top for the mips
+	if (_config.occlusion) f.gpu += pixels * F * 4 / 3;
+	//ao + blurred ao, at a lower scale the depth, ao and blur target there and the upsampled ao
+	if (_config.ssao) f.gpu += _config.ssaoScale > 1 ? pixels / (_config.ssaoScale * _config.ssaoScale) * (4 + 2 + 2) + pixels : pixels * (2 + 1);
+	//grid of at most 2 cells per atom (count and start), cell and slot, sorted atoms and the occlusion per atom, one per visible centre
+	if (_config.atomAO) f.gpu += (2 * 2 + 2 + 1 + 1) * A * sizeof(uint);
+	if (_config.atomAO && _config.culling) f.gpu += A * F * (_config.impostors ? 1 : _config.sphereSubdivisions + 1) * (_config.occlusion ? 2 : 1);
+	//two RGB16F histories at the ssao resolution
+	if (_config.ssao && _config.ssaoTemporal) f.gpu += pixels / (_config.ssaoScale * _config.ssaoScale) * 2 * 6;
+	return f;
+}
+
+bool Memory::fits(const Config& _config, const Footprint& _footprint) {
+	const size_t MB = 1024 * 1024;
+	const size_t cpuBudget = _config.cpuBudget * MB;
+	const size_t gpuBudget = _config.gpuBudget * MB;
+	return (!cpuBudget || _footprint.cpu <= cpuBudget) && (!gpuBudget || _footprint.gpu <= gpuBudget);
+}
+
+uint Memory::fit(Config& _config, uint _atoms, uint _steps, int _width, int _height) {
+	const size_t MB = 1024 * 1024;
+	const size_t cpuBudget = _config.cpuBudget * MB;
+	const size_t gpuBudget = _config.gpuBudget * MB;
+
+	uint stride = 1;
+	Footprint f = estimate(_config, _atoms, _steps, stride, _width, _height);
+	Logger::LOG("LOG:\tPlanned memory: cpu " + std::to_string(f.cpu / MB) + " MB (budget " + (cpuBudget ? std::to_string(_config.cpuBudget) + " MB" : std::string("unlimited"))
+		+ "), gpu " + std::to_string(f.gpu / MB) + " MB (budget " + (gpuBudget ? std::to_string(_config.gpuBudget) + " MB" : std::string("unlimited")) + ")", true);
+
+	while (!fits(_config, f)) {
+		//the sphere mesh is shared by all atoms, its subdivisions cost no memory worth trading
+		if (_config.interpolation == 2) {
+			_config.interpolation = 3;
+			Logger::LOG("WARNING:\tOver memory budget. Using Catmull-Rom interpolation, no spline weights", true);
+		} else if (_steps > 2 && (_steps - 2) / (stride * 2) >= 1) {
+			stride *= 2;
+			Logger::LOG("WARNING:\tOver memory budget. Using every " + std::to_string(stride) + ". step only", true);
+		} else {
+			Logger::LOG("WARNING:\tThe trajectory does not fit the memory budget, even with every fallback", true);
+			break;
+		}
+		f = estimate(_config, _atoms, _steps, stride, _width, _height);
+	}
+	return stride;
+}
+
+void Memory::log() {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	const char* pools[] = { "cpu", "gpu" };
+	Logger::LOG("LOG:\tMemory [KiB] current/ peak:", true);
+	for (uint p = 0; p < 2; ++p) {
+		Logger::LOG("\t -> " + std::string(pools[p]) + ": " + std::to_string(m->total[p] / 1024) + "/ " + std::to_string(m->peak[p] / 1024), false);
+		for (const Category& c : m->categories[p])
+			Logger::LOG("\t\t" + c.name + ": " + std::to_string(c.bytes / 1024) + "/ " + std::to_string(c.peak / 1024), false);
+	}
+	Logger::LOG("", false);
+}
+
+void Memory::writeJson(std::ostream& _out, const std::string& _indent) {
+	Memory* m = get();
+	std::lock_guard<std::mutex> lock(m->mutex);
+	const char* pools[] = { "cpu", "gpu" };
+	std::vector<std::string> entries;
+	for (uint p = 0; p < 2; ++p)
+		for (const Category& c : m->categories[p])
+			entries.push_back("{ \"pool\": \"" + std::string(pools[p]) + "\", \"name\": \"" + c.name + "\", \"bytes\": " + std::to_string(c.bytes) + ", \"peak_bytes\": " + std::to_string(c.peak) + " }");
+	_out << "[\n";
+	for (size_t i = 0; i < entries.size(); ++i)
+		_out << _indent << "\t" << entries[i] << (i + 1 < entries.size() ? ",\n" : "\n");
+	_out << _indent << "]";
+}
+
+Memory* Memory::get() {
+	return instance;
+}
+
+Profiler::Scope::Scope(const std::string& _name, size_t _bytes) : name(_name), bytes(_bytes), start(std::chrono::high_resolution_clock::now()) {}
+
+Profiler::Scope::~Scope() {
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	Profiler::record(name, elapsed.count(), bytes);
+}
+
+void Profiler::Scope::addBytes(size_t _bytes) {
+	bytes += _bytes;
+}
+
 void ShaderProgram::print(std::string _id, ShaderProgram::Status _compComp, ShaderProgram::Status _compVert,
 	ShaderProgram::Status _compGeom, ShaderProgram::Status _compFrag, ShaderProgram::Status _link, std::string _errorLog) {
 	if (!printDebug) return;
@@ -41,6 +274,19 @@ void ShaderProgram::print(std::string _id, ShaderProgram::Status _compComp, Shad
 }
 
 bool ShaderProgram::compileFromFile(const std::string& _path) {
+	return compileFromFile(_path, "");
+}
+
+static std::string injectDefines(const std::string& _source, const std::string& _defines) {
+	if (_source.empty() || _defines.empty()) return _source;
+	const size_t version = _source.find("#version");
+	if (version == std::string::npos) return _defines + _source;
+	const size_t eol = _source.find('\n', version);
+	if (eol == std::string::npos) return _source + "\n" + _defines;
+	return _source.substr(0, eol + 1) + _defines + _source.substr(eol + 1);
+}
+
+bool ShaderProgram::compileFromFile(const std::string& _path, const std::string& _defines) {
 	bool cExists = true;
 	bool vExists = true;
 	bool gExists = true;
@@ -58,11 +304,15 @@ bool ShaderProgram::compileFromFile(const std::string& _path) {
 	std::ifstream fragB(_path + ".frag");
 	fExists = fragB.good();
 
-	bool success = compile(
-		(cExists ? std::string{ std::istreambuf_iterator<char>(compB), std::istreambuf_iterator<char>() } : "").c_str(),
-		(vExists ? std::string{ std::istreambuf_iterator<char>(vertB), std::istreambuf_iterator<char>() } : "").c_str(),
-		(gExists ? std::string{ std::istreambuf_iterator<char>(geomB), std::istreambuf_iterator<char>() } : "").c_str(),
-		(fExists ? std::string{ std::istreambuf_iterator<char>(fragB), std::istreambuf_iterator<char>() } : "").c_str());
+	Profiler::Scope scope("shader_compile");
+
+	const std::string comp = cExists ? injectDefines(std::string{ std::istreambuf_iterator<char>(compB), std::istreambuf_iterator<char>() }, _defines) : "";
+	const std::string vert = vExists ? injectDefines(std::string{ std::istreambuf_iterator<char>(vertB), std::istreambuf_iterator<char>() }, _defines) : "";
+	const std::string geo = gExists ? injectDefines(std::string{ std::istreambuf_iterator<char>(geomB), std::istreambuf_iterator<char>() }, _defines) : "";
+	const std::string frg = fExists ? injectDefines(std::string{ std::istreambuf_iterator<char>(fragB), std::istreambuf_iterator<char>() }, _defines) : "";
+	scope.addBytes(comp.size() + vert.size() + geo.size() + frg.size());
+
+	bool success = compile(comp.c_str(), vert.c_str(), geo.c_str(), frg.c_str());
 
 	compB.close();
 	vertB.close();
@@ -260,105 +510,51 @@ void Camera::lookAt(const Vec3& _pos) {
 	view = glm::lookAt(position, _pos, up);
 }
 
+void Camera::frustum(Vec4 (&_planes)[6]) const {
+	//row 3 +- row 0, 1, 2 of the clip matrix (Gribb, Hartmann)
+	const Mat4 rows = glm::transpose(combined);
+	for (int i = 0; i < 3; ++i) {
+		_planes[2 * i] = rows[3] + rows[i];
+		_planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (Vec4& p : _planes)
+		p /= glm::length(Vec3(p));
+}
+
 void Camera::normalizeUp() {
 	right = glm::normalize(glm::cross(direction, up));
 	//up = NOR(CRS(right, direction));
 }
 
-std::pair<std::vector<float>, std::vector<uint>> Icosahedron::create(uint _subdivisions) {
-	
-	const float X = .525731112119133606f;
-	const float Z = .850650808352039932f;
-	const float N = 0.f;
-
-	struct Triangle { uint vertex[3]; };
-
-	using TriangleList = std::vector<Triangle>;
-	using VertexList = std::vector<Vec3>;
-
-	const VertexList vertices =
-	{
-	  {-X,N,Z}, {X,N,Z}, {-X,N,-Z}, {X,N,-Z},
-	  {N,Z,X}, {N,Z,-X}, {N,-Z,X}, {N,-Z,-X},
-	  {Z,X,N}, {-Z,X, N}, {Z,-X,N}, {-Z,-X, N}
-	};
-
-	const TriangleList triangles =
-	{
-	  {0,4,1},{0,9,4},{9,5,4},{4,5,8},{4,8,1},
-	  {8,10,1},{8,3,10},{5,3,8},{5,2,3},{2,7,3},
-	  {7,10,3},{7,6,10},{7,11,6},{11,0,6},{0,1,6},
-	  {6,1,10},{9,0,11},{9,11,2},{9,2,5},{7,2,11}
-	};
-
-	using Lookup = std::map<std::pair<uint, uint>, uint>;
-
-	auto vertex_for_edge = [&](Lookup& lookup, VertexList& vertices, uint first, uint second)->uint {
-		Lookup::key_type key(first, second);
-		if (key.first > key.second)
-			std::swap(key.first, key.second);
-
-		auto inserted = lookup.insert({ key, static_cast<uint>(vertices.size()) });
-		if (inserted.second) {
-			auto& edge0 = vertices[first];
-			auto& edge1 = vertices[second];
-			auto point = normalize(edge0 + edge1);
-			vertices.push_back(point);
-		}
-
-		return inserted.first->second;
-	};
+template<uint L>
+static Icosphere::Mesh icosphereView() {
+	return { Icosphere::table<L>.vertices.data(), Icosphere::table<L>.aux.data(), Icosphere::table<L>.indices.data(), Icosphere::Table<L>::VERTICES, Icosphere::Table<L>::INDICES };
+}
 
-	auto subdivide = [&](VertexList& vertices, TriangleList triangles)->TriangleList {
-		Lookup lookup;
-		TriangleList result;
-
-		for (auto&& each : triangles) {
-			std::array<uint, 3> mid;
-			for (int edge = 0; edge < 3; ++edge) {
-				mid[edge] = vertex_for_edge(lookup, vertices,
-					each.vertex[edge], each.vertex[(edge + 1) % 3]);
-			}
-
-			result.push_back({ each.vertex[0], mid[0], mid[2] });
-			result.push_back({ each.vertex[1], mid[1], mid[0] });
-			result.push_back({ each.vertex[2], mid[2], mid[1] });
-			result.push_back({ mid[0], mid[1], mid[2] });
+Icosphere::Mesh Icosahedron::get(uint _subdivisions) {
+	static_assert(Icosphere::TABLE_SUBDIVISIONS == 3u, "add the new tables to Icosahedron::get");
+	switch (_subdivisions) {
+		case 0: return icosphereView<0>();
+		case 1: return icosphereView<1>();
+		case 2: return icosphereView<2>();
+		case 3: return icosphereView<3>();
+		default: {
+			//built on first use, the loader thread and the render thread may both ask
+			static const std::vector<Icosphere::Buffers> generated = Icosphere::generate();
+			const uint level = std::min(_subdivisions, Icosphere::MAX_SUBDIVISIONS);
+			return generated[level - Icosphere::TABLE_SUBDIVISIONS - 1].view();
 		}
-
-		return result;
-	};
-
-	VertexList vert = vertices;
-	TriangleList tria = triangles;
-
-	for (unsigned int i = 0; i < _subdivisions; ++i) {
-		tria = subdivide(vert, tria);
-	}
-
-	std::vector<float> v_out(vert.size() * 3);
-	std::vector<uint> i_out(tria.size() * 3);
-
-	for (size_t i = 0, j = 0; i < vert.size(); ++i, j += 3) {
-		auto v = glm::normalize(vert[i]);
-		v_out[j] = v[0];
-		v_out[j + 1] = v[1];
-		v_out[j + 2] = v[2];
-	}
-
-	//for (const auto& t : tria) {
-	for (size_t i = 0, j = 0; i < tria.size(); ++i, j += 3) {
-		auto& t = tria[i];
-		i_out[j] = t.vertex[0];
-		i_out[j + 1] = t.vertex[1];
-		i_out[j + 2] = t.vertex[2];
 	}
+}
 
-	return{ v_out, i_out };
+void FileParser::loadFile(std::string _path, bool _binary, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims) {
+	if (_binary)
+		loadBinary(_path, _coords, _count, _low, _up, _dims);
+	else
+		loadAscii(_path, _coords, _count, _low, _up, _dims);
 }
 
-#if USE_BINARY
-void FileParser::loadFile(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims) {
+void FileParser::loadBinary(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims) {
 	Logger::LOG("\t" + _path, false);
 	std::ifstream in(_path, std::ios::binary | std::ios::in);
 	std::vector<char> buffer(std::istreambuf_iterator<char>(in), {});	
@@ -394,8 +590,8 @@ void FileParser::loadFile(std::string _path, std::vector<float>& _coords, uint&
 	std::memcpy(_coords.data() + c, _coords.data(), _count * 3 * sizeof(float));
 
 }
-#else
-void FileParser::loadFile(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims) {
+
+void FileParser::loadAscii(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims) {
 	Logger::LOG("\t" + _path, false);
 	std::fstream in(_path);
 	Logger::LOG("\tFile status: " + std::string(in.good() ? "OK" : "FAILED"), false);
@@ -431,7 +627,225 @@ void FileParser::loadFile(std::string _path, std::vector<float>& _coords, uint&
 	for(uint i = 0; i < _count*3; ++i)
 		_coords.emplace_back(_coords[i]);
 }
-#endif // USE_BINARY
+
+uint FileParser::stride(std::vector<float>& _coords, uint _count, uint _stride) {
+	const size_t frame = static_cast<size_t>(_count) * 3;
+	const uint steps = static_cast<uint>(_coords.size() / frame);
+	if (_stride <= 1 || steps < 3) return steps;
+
+	//the last frame is the copy of frame 0 the parser appended
+	uint out = 0;
+	for (uint s = 0; s < steps - 1; s += _stride, ++out)
+		if (out != s) std::memcpy(_coords.data() + out * frame, _coords.data() + s * frame, frame * sizeof(float));
+	std::memcpy(_coords.data() + out * frame, _coords.data() + (steps - 1) * frame, frame * sizeof(float));
+	++out;
+
+	_coords.resize(out * frame);
+	_coords.shrink_to_fit();
+	return out;
+}
+
+static bool parseValue(const std::string& _value, std::string& _out) {
+	_out = _value;
+	return true;
+}
+
+static bool parseValue(const std::string& _value, uint& _out) {
+	std::istringstream in(_value);
+	long long v;
+	if (!(in >> v) || v < 0 || !(in >> std::ws).eof()) return false;
+	_out = static_cast<uint>(v);
+	return true;
+}
+
+static bool parseValue(const std::string& _value, float& _out) {
+	std::istringstream in(_value);
+	float v;
+	if (!(in >> v) || !(in >> std::ws).eof()) return false;
+	_out = v;
+	return true;
+}
+
+static bool parseValue(const std::string& _value, bool& _out) {
+	if (_value == "1" || _value == "true" || _value == "on") _out = true;
+	else if (_value == "0" || _value == "false" || _value == "off") _out = false;
+	else return false;
+	return true;
+}
+
+bool Config::set(const std::string& _key, const std::string& _value) {
+	const std::map<std::string, std::function<bool(const std::string&)>> options = {
+		{ "config", [&](const std::string& _v) { return parseValue(_v, configFile); } },
+		{ "window-width", [&](const std::string& _v) { return parseValue(_v, windowWidth); } },
+		{ "window-height", [&](const std::string& _v) { return parseValue(_v, windowHeight); } },
+		{ "binary", [&](const std::string& _v) { return parseValue(_v, binary); } },
+		{ "interpolation", [&](const std::string& _v) { return parseValue(_v, interpolation); } },
+		{ "cyclic-boundaries", [&](const std::string& _v) { return parseValue(_v, cyclicBoundaries); } },
+		{ "spline-on-gpu", [&](const std::string& _v) { return parseValue(_v, splineOnGPU); } },
+		{ "sphere-subdivisions", [&](const std::string& _v) { return parseValue(_v, sphereSubdivisions); } },
+		{ "impostors", [&](const std::string& _v) { return parseValue(_v, impostors); } },
+		{ "culling", [&](const std::string& _v) { return parseValue(_v, culling); } },
+		{ "occlusion", [&](const std::string& _v) { return parseValue(_v, occlusion); } },
+		{ "compact-gbuffer", [&](const std::string& _v) { return parseValue(_v, compactGBuffer); } },
+		{ "widget", [&](const std::string& _v) { return parseValue(_v, widget); } },
+		{ "widget-width", [&](const std::string& _v) { return parseValue(_v, widgetWidth); } },
+		{ "widget-height", [&](const std::string& _v) { return parseValue(_v, widgetHeight); } },
+		{ "log-frames", [&](const std::string& _v) { return parseValue(_v, logFrames); } },
+		{ "ssao", [&](const std::string& _v) { return parseValue(_v, ssao); } },
+		{ "ssao-kernel-size", [&](const std::string& _v) { return parseValue(_v, ssaoKernelSize); } },
+		{ "ssao-radius", [&](const std::string& _v) { return parseValue(_v, ssaoRadius); } },
+		{ "ssao-bias", [&](const std::string& _v) { return parseValue(_v, ssaoBias); } },
+		{ "ssao-scale", [&](const std::string& _v) { return parseValue(_v, ssaoScale); } },
+		{ "ssao-temporal", [&](const std::string& _v) { return parseValue(_v, ssaoTemporal); } },
+		{ "atom-ao", [&](const std::string& _v) { return parseValue(_v, atomAO); } },
+		{ "atom-ao-radius", [&](const std::string& _v) { return parseValue(_v, atomAORadius); } },
+		{ "profile", [&](const std::string& _v) { return parseValue(_v, profile); } },
+		{ "profile-report", [&](const std::string& _v) { return parseValue(_v, profileReport); } },
+		{ "task-budget", [&](const std::string& _v) { return parseValue(_v, taskBudget); } },
+		{ "upload-slice", [&](const std::string& _v) { return parseValue(_v, uploadSlice); } },
+		{ "memory-budget-cpu", [&](const std::string& _v) { return parseValue(_v, cpuBudget); } },
+		{ "memory-budget-gpu", [&](const std::string& _v) { return parseValue(_v, gpuBudget); } },
+		{ "threads", [&](const std::string& _v) { return parseValue(_v, threads); } },
+		{ "validate-spline", [&](const std::string& _v) { return parseValue(_v, validateSpline); } },
+		{ "compact-spline", [&](const std::string& _v) { return parseValue(_v, compactSpline); } },
+		{ "motion", [&](const std::string& _v) { return parseValue(_v, motion); } },
+	};
+
+	auto it = options.find(_key);
+	if (it == options.end()) {
+		Logger::LOG("ERROR:\tUnknown option '" + _key + "'", true);
+		return false;
+	}
+	if (!it->second(_value)) {
+		Logger::LOG("ERROR:\tInvalid value '" + _value + "' for option '" + _key + "'", true);
+		return false;
+	}
+	return true;
+}
+
+bool Config::loadFile(const std::string& _path, bool _required) {
+	std::ifstream in(_path);
+	if (!in.good()) {
+		if (_required) Logger::LOG("ERROR:\tCan't open config file " + _path, true);
+		return !_required;
+	}
+
+	auto trim = [](const std::string& _s)->std::string {
+		const size_t b = _s.find_first_not_of(" \t\r");
+		if (b == std::string::npos) return "";
+		const size_t e = _s.find_last_not_of(" \t\r");
+		return _s.substr(b, e - b + 1);
+	};
+
+	bool success = true;
+	std::string line;
+	while (std::getline(in, line)) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) continue;
+		const size_t eq = line.find('=');
+		if (eq == std::string::npos) {
+			Logger::LOG("ERROR:\tExpected key = value in " + _path + ": " + line, true);
+			success = false;
+			continue;
+		}
+		success &= set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+	}
+	return success;
+}
+
+bool Config::parseArgs(int _argc, char* _argv[]) {
+	//the config file has to be known before the flags get applied
+	bool explicitConfig = false;
+	for (int i = 1; i < _argc; ++i) {
+		const std::string arg(_argv[i]);
+		if (arg.rfind("--config=", 0) == 0) {
+			configFile = arg.substr(9);
+			explicitConfig = true;
+		}
+	}
+	bool success = loadFile(explicitConfig ? configFile : VSC_WORKDIR_OFFSET + configFile, explicitConfig);
+
+	for (int i = 1; i < _argc; ++i) {
+		const std::string arg(_argv[i]);
+		if (arg == "--help" || arg == "-h") {
+			usage();
+			return false;
+		}
+		if (arg.rfind("--", 0) != 0) {
+			trajectory = arg;
+			continue;
+		}
+		const size_t eq = arg.find('=');
+		//a bare --flag enables a boolean option
+		success &= eq == std::string::npos ? set(arg.substr(2), "1") : set(arg.substr(2, eq - 2), arg.substr(eq + 1));
+	}
+
+	validate();
+	return success;
+}
+
+void Config::validate() {
+	if (interpolation > 3) {
+		Logger::LOG("WARNING:\tinterpolation must be 0, 1, 2 or 3. Using 2.", true);
+		interpolation = 2;
+	}
+	if (compactSpline && !cyclicBoundaries) {
+		Logger::LOG("WARNING:\tcompact-spline stores the positions wrapped into the box and needs cyclic-boundaries. Using float weights.", true);
+		compactSpline = false;
+	}
+	if (occlusion && !culling) {
+		Logger::LOG("WARNING:\tocclusion needs culling. Enabling culling.", true);
+		culling = true;
+	}
+	if (sphereSubdivisions > Icosphere::MAX_SUBDIVISIONS) {
+		Logger::LOG("WARNING:\tsphere-subdivisions must be in [0, " + std::to_string(Icosphere::MAX_SUBDIVISIONS) + "]. Using " + std::to_string(Icosphere::MAX_SUBDIVISIONS) + ".", true);
+		sphereSubdivisions = Icosphere::MAX_SUBDIVISIONS;
+	}
+	ssaoKernelSize = std::clamp(ssaoKernelSize, 1u, 256u);
+	if (ssaoScale != 1 && ssaoScale != 2 && ssaoScale != 4) {
+		Logger::LOG("WARNING:\tssao-scale must be 1, 2 or 4. Using 1.", true);
+		ssaoScale = 1;
+	}
+	if (atomAO && ssao) {
+		Logger::LOG("LOG:\tatom-ao replaces ssao. Disabling ssao.", true);
+		ssao = false;
+	}
+	if (atomAO && atomAORadius <= 0.f) {
+		Logger::LOG("WARNING:\tatom-ao-radius must be positive. Using " + std::to_string(ATOM_AO_RADIUS) + ".", true);
+		atomAORadius = ATOM_AO_RADIUS;
+	}
+	if (ssao && ssaoTemporal && ssaoKernelSize > SSAO_TEMPORAL_KERNEL) {
+		Logger::LOG("LOG:\tssao-temporal accumulates over frames, using " + std::to_string(SSAO_TEMPORAL_KERNEL) + " kernel samples per frame.", true);
+		ssaoKernelSize = SSAO_TEMPORAL_KERNEL;
+	}
+	windowWidth = std::max(windowWidth, 1u);
+	windowHeight = std::max(windowHeight, 1u);
+	taskBudget = std::max(taskBudget, 0.f);
+	uploadSlice = std::max(uploadSlice, 1u);
+}
+
+void Config::print() const {
+	Logger::LOG("LOG:\tConfiguration:", true);
+	Logger::LOG("\t -> Window: " + std::to_string(windowWidth) + "x" + std::to_string(windowHeight) + (widget ? ", widget " + std::to_string(widgetWidth) + "x" + std::to_string(widgetHeight) : ""), false);
+	Logger::LOG("\t -> Input: " + std::string(binary ? "binary" : "ascii") + ", cyclic boundaries: " + std::to_string(cyclicBoundaries), false);
+	Logger::LOG("\t -> Interpolation: " + std::to_string(interpolation) + ", spline on gpu: " + std::to_string(splineOnGPU) + (validateSpline ? " (validated)" : "") + (compactSpline ? ", compact weights" : "") + (motion ? ", motion channels" : ""), false);
+	Logger::LOG("\t -> Spheres: " + (impostors ? std::string("ray cast impostors") : "subdivisions " + std::to_string(sphereSubdivisions)) + (culling ? (occlusion ? ", gpu frustum and occlusion culling" : ", gpu culling") : ""), false);
+	Logger::LOG("\t -> Loading: " + std::to_string(taskBudget) + " ms per frame, upload slices of " + std::to_string(uploadSlice) + " MB, " + (threads ? std::to_string(threads) : std::string("all")) + " cpu threads", false);
+	Logger::LOG("\t -> Memory budget [MB]: cpu " + (cpuBudget ? std::to_string(cpuBudget) : std::string("unlimited")) + ", gpu " + (gpuBudget ? std::to_string(gpuBudget) : std::string("driver")), false);
+	Logger::LOG("\t -> G-buffer: " + std::string(compactGBuffer ? "compact, position from depth" : "full"), false);
+	if (atomAO)
+		Logger::LOG("\t -> Atom AO: shell radius " + std::to_string(atomAORadius), false);
+	Logger::LOG("\t -> SSAO: " + (ssao ? "kernel " + std::to_string(ssaoKernelSize) + ", radius " + std::to_string(ssaoRadius) + ", bias " + std::to_string(ssaoBias) + (ssaoScale > 1 ? ", 1/" + std::to_string(ssaoScale) + " resolution" : "") + (ssaoTemporal ? ", temporal" : "") : std::string("off")) + "\n", false);
+}
+
+void Config::usage() {
+	Logger::LOG("usage: mdvis [path] [--config=file] [--key=value ...]", false);
+	Logger::LOG("keys (config file and flags): window-width, window-height, binary, interpolation, cyclic-boundaries,", false);
+	Logger::LOG("\tspline-on-gpu, sphere-subdivisions, widget, widget-width, widget-height, log-frames, ssao,", false);
+	Logger::LOG("\tssao-kernel-size, ssao-radius, ssao-bias, ssao-scale, ssao-temporal, profile, profile-report,", false);
+	Logger::LOG("\ttask-budget, upload-slice, memory-budget-cpu, memory-budget-gpu, threads, validate-spline,", false);
+	Logger::LOG("\tcompact-spline, motion, impostors, culling, occlusion, compact-gbuffer, atom-ao, atom-ao-radius", false);
+}
 
 CameraController::CameraController(Camera* _cam) : camera(_cam){}
 
@@ -499,107 +913,146 @@ void CameraController::update(GLFWwindow* _window, float _delta) {
 
 }
 
-#if !COMPUTE_SPLINE_ON_GPU
-void SplineBuilder::build(uint _count, uint _steps, const Vec3& dims, std::vector<float>& _traj, std::vector<float>& _out) {
-	//cyclic boundary conditions
-	{
-		_out.resize(12 * _count * _steps);
-		const float hx = dims.x;
-		const float hy = dims.y;
-		const float hz = dims.z;
-
-		const float hx2 = hx / 2.f;
-		const float hy2 = hy / 2.f;
-		const float hz2 = hz / 2.f;
-
-		const float t = 1.f / float(_steps);
-		const float m2 = (2.f * t) / 3.;
-		const float m13 = t / 6.f;
-
-
-		for (uint idx = 0; idx < _count; ++idx) {
-
-			//remove cyclic boundary conditions
-			float osx = 0.f, osy = 0.f, osz = 0.f;
-
-			for (uint i = 1; i < _steps; ++i) {
-				const uint offsetL = 3 * idx + (i - 1) * _count * 3;
-				const uint offsetH = 3 * idx + i * _count * 3;
-
-				const float dx = _traj[offsetH] - _traj[offsetL];
-				const float dy = _traj[offsetH + 1] - _traj[offsetL + 1];
-				const float dz = _traj[offsetH + 2] - _traj[offsetL + 2];
-
-				_traj[offsetL] += osx * hx;
-				_traj[offsetL + 1] += osy * hy;
-				_traj[offsetL + 2] += osz * hz;
-
-				osx += dx >= hx2 ? -1.f : dx <= -hx2 ? 1.f : 0.f;
-				osy += dy >= hy2 ? -1.f : dy <= -hy2 ? 1.f : 0.f;
-				osz += dz >= hz2 ? -1.f : dz <= -hz2 ? 1.f : 0.f;
-			}
-
-			std::vector<float> tmp(_steps);
-			std::vector<float> x(_steps);
-
-			//dims
-			for (uint k = 0; k < 3; ++k) {
-
-				//rhs
-				for (uint i = 1; i < _steps - 1; ++i) {
-
-					const uint offsetL = 3 * idx + (i - 1) * _count * 3 + k;
-					const uint offsetM = 3 * idx + i * _count * 3 + k;
-					const uint offsetH = 3 * idx + (i + 1) * _count * 3 + k;
-
-					x[i] = (_traj[offsetH] - _traj[offsetM]) / t - (_traj[offsetM] - _traj[offsetL]) / t;
-					tmp[i] = 0.f;
-				}
-
-				//boundary conditions
-				x[0] = 3.f * ((_traj[3 * idx + _count * 3 + k] - _traj[3 * idx + k]) / t);
-				x[_steps - 1] = 3.0 * (-(_traj[3 * idx + (_steps - 1) * _count * 3 + k] - _traj[3 * idx + (_steps - 2) * _count * 3 + k]) / t);
-
-				//solve
-				tmp[0] = m13 / m2;
-				x[0] = x[0] / m2;
-
-				for (uint i = 1; i < _steps; ++i) {
-					const float m = 1.f / (m2 - m13 * tmp[i - 1]);
-					tmp[i] = m13 * m;
-					x[i] = (x[i] - m13 * x[i - 1]) * m;
-				}
-
-				for (uint i = _steps - 2; i > 0; --i)
-					x[i] -= tmp[i] * x[i + 1];
-				x[0] -= tmp[0] * x[1];
-
-				if (idx == 0) {
-					for (uint i = 0; i < _steps; ++i)
-						_out[i] = x[i];
-				}
-
-				//calc weights
-				for (uint i = 1; i < _steps; ++i) {
-
-					const uint offsetL = 3 * idx + (i - 1) * _count * 3 + k;
-					const uint offsetM = 3 * idx + i * _count * 3 + k;
-
-					const uint offset = 12 * idx + (i - 1) * _count * 12 + k;
+void SplineBuilder::build(uint _count, uint _steps, const std::vector<float>& _traj, std::vector<float>& _out) {
+	_out.resize(12 * static_cast<size_t>(_count) * _steps);
+
+	ThreadPool& pool = ThreadPool::get();
+
+	//windows of segments times blocks of atoms, all independent
+	const uint rows = std::min(_steps, Spline::windowRows(Spline::WINDOW));
+	const Spline::Factorization factorization(_steps, rows);
+	const uint block = Spline::blockSize(rows);
+	const uint blocks = (_count + block - 1) / block;
+	const uint windows = (_steps + Spline::WINDOW - 1) / Spline::WINDOW;
+
+	//scratch is allocated once per thread, not per task
+	std::vector<std::vector<float>> scratch(pool.size());
+	pool.run(windows * blocks, [&](uint _task, uint _thread) {
+		std::vector<float>& x = scratch[_thread];
+		if (x.empty()) x.resize(static_cast<size_t>(rows) * 3 * std::min(block, _count));
+		const uint first = (_task / blocks) * Spline::WINDOW;
+		const uint last = std::min(first + Spline::WINDOW, _steps);
+		const uint begin = (_task % blocks) * block;
+		Spline::build(factorization, _traj.data(), 0, _count, _steps, first, last, begin, std::min(begin + block, _count), x.data(),
+			_out.data() + static_cast<size_t>(first) * _count * 12);
+	});
+}
 
-					_out[offset] = _traj[offsetL];
-					_out[offset + 3] = (_traj[offsetM] - _traj[offsetL]) / t - (t * (2 * x[i - 1] + x[i])) / 6.f;
-					_out[offset + 6] = x[i - 1] / 2.f;
-					_out[offset + 9] = (x[i] - x[i - 1]) / (6 * t);
+float SplineBuilder::compact(uint _count, uint _steps, const Vec3& dims, const std::vector<float>& _weights, std::vector<uint>& _out) {
+	_out.resize(6 * static_cast<size_t>(_count) * _steps);
+
+	ThreadPool& pool = ThreadPool::get();
+	const uint range = (_steps + pool.size() - 1) / pool.size();
+	std::vector<float> deviation(pool.size(), 0.f);
+	pool.run(pool.size(), [&](uint _chunk, uint _thread) {
+		const uint begin = std::min(_chunk * range, _steps);
+		const uint end = std::min(begin + range, _steps);
+		const float d = Spline::compact(_weights.data(), _count, _steps, dims, begin, end, _out.data());
+		deviation[_thread] = std::max(deviation[_thread], d);
+	});
+	return *std::max_element(deviation.begin(), deviation.end());
+}
 
-				}
+void SplineBuilder::buildGPU(uint _count, uint _steps, const Vec3& dims, bool _compact, GLuint _traj, GLuint _weights, bool _wait) {
+	//compact weights get or-ed together from 16 bit halves
+	if (_compact) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _weights);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
 
-			}
-		}
-		
+	//second derivatives, one float per atom coordinate and step
+	const size_t tmpSize = static_cast<size_t>(_count) * 3 * _steps * sizeof(float);
+	GLuint tmp;
+	glGenBuffers(1, &tmp);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tmp);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tmpSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	Memory::alloc(Memory::GPU, "spline scratch", tmpSize);
+
+	//the matrix is the same for every atom, factorize it once here
+	const Spline::Factorization factorization(_steps);
+	std::vector<float> factors(factorization.m);
+	factors.insert(factors.end(), factorization.c.begin(), factorization.c.end());
+	GLuint fac;
+	glGenBuffers(1, &fac);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, fac);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, factors.size() * sizeof(float), factors.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	//workgroups of 256 invocations. The time axis is cut into up to 64 chunks of at least 16 steps,
+	//the rest of the workgroup takes more atom coordinates
+	uint parts = 1;
+	while (parts < 64 && parts * 32 <= _steps)
+		parts *= 2;
+	const uint lanes = 256 / parts;
+
+	ShaderProgram shader;
+	shader.id = "t_shader";
+	shader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/t_shader")).string(),
+		"#define LANES " + std::to_string(lanes) + "\n#define PARTS " + std::to_string(parts) + "\n" + (_compact ? "#define COMPACT\n" : ""));
+	shader.bind();
+
+	//buffers
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _traj);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _weights);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tmp);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, fac);
+
+	//uniforms
+	glUniform1i(1, _count);
+	glUniform1i(2, _steps);
+	glUniform3fv(3, 1, glm::value_ptr(dims));
+
+	//0.75 groups per atom at 64 parts, past the guaranteed 65535 in x from ~87k atoms on. The rest goes to y
+	GLint maxGroups = 65535;
+	glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroups);
+	const uint groups = (_count * 3 + lanes - 1) / lanes;
+	const uint groupsX = std::min(groups, static_cast<uint>(maxGroups));
+	glDispatchCompute(groupsX, (groups + groupsX - 1) / groupsX, 1);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, 0);
+	shader.unbind();
+
+	glDeleteBuffers(1, &tmp);
+	glDeleteBuffers(1, &fac);
+	Memory::release(Memory::GPU, "spline scratch", tmpSize);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	//the dispatch is asynchronous. Only a caller that times the build waits for it, and only for this dispatch
+	if (_wait) {
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
 	}
+}
 
+//runs _fn(time, begin, end, out) over samples times blocks of atoms
+template<typename Fn>
+static void evaluateBatch(const std::vector<float>& _times, uint _begin, uint _end, std::vector<float>& _out, Fn _fn) {
+	const uint atoms = _end > _begin ? _end - _begin : 0;
+	_out.resize(_times.size() * atoms * 3);
+	//16k atoms of positions per task stay in L2
+	const uint block = 1u << 14;
+	const uint blocks = (atoms + block - 1) / block;
+	ThreadPool::get().run(static_cast<uint>(_times.size()) * blocks, [&](uint _task, uint) {
+		const uint sample = _task / blocks;
+		const uint begin = _begin + (_task % blocks) * block;
+		_fn(_times[sample], begin, std::min(begin + block, _end), _out.data() + (static_cast<size_t>(sample) * atoms + begin - _begin) * 3);
+	});
 }
-#endif // COMPUTE_SPLINE_ON_GPU
 
+void SplineBuilder::evaluate(uint _count, uint _steps, const Vec3& dims, bool _wrap, const std::vector<float>& _weights, const std::vector<float>& _times, uint _begin, uint _end, std::vector<float>& _out) {
+	evaluateBatch(_times, _begin, _end, _out, [&](float _t, uint _b, uint _e, float* _o) {
+		Spline::evaluate(_weights.data(), _count, _steps, _t, dims, _wrap, _b, _e, _o);
+	});
+}
 
+void SplineBuilder::evaluate(uint _count, uint _steps, const Vec3& dims, const std::vector<uint>& _weights, const std::vector<float>& _times, uint _begin, uint _end, std::vector<float>& _out) {
+	evaluateBatch(_times, _begin, _end, _out, [&](float _t, uint _b, uint _e, float* _o) {
+		Spline::evaluate(_weights.data(), _count, _steps, _t, dims, _b, _e, _o);
+	});
+}
@@ -1,5 +1,6 @@
 
 #include "Defines.h"
+#include "Icosphere.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -36,6 +37,11 @@ public:
 	fragment shader: [PATH_TO_FILE].frag
 	*/
 	bool compileFromFile(const std::string&);
+	/*
+	same as above, _defines gets inserted right after the #version line of every stage.
+	used to specialize shaders for the runtime configuration.
+	*/
+	bool compileFromFile(const std::string&, const std::string& _defines);
 	bool compile(const char*, const char*, const char*, const char*);
 	GLuint getHandle();
 	void bind();
@@ -69,6 +75,8 @@ public:
 
 	void lookAt(const Vec3&);
 	void normalizeUp();
+	//planes of the view frustum of combined as (normal, distance), the normals point inside
+	void frustum(Vec4 (&_planes)[6]) const;
 
 };
 
@@ -91,11 +99,70 @@ public:
 };
 
 struct Icosahedron {
-	static std::pair<std::vector<float>, std::vector<uint>>create(uint);
+	/*
+	returns the icosphere with the given subdivisions, precomputed or generated on first use. valid range: [0, Icosphere::MAX_SUBDIVISIONS]
+	*/
+	static Icosphere::Mesh get(uint);
 };
 
 struct FileParser {
-	static void loadFile(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims);
+	static void loadFile(std::string _path, bool _binary, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims);
+	static void loadBinary(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims);
+	static void loadAscii(std::string _path, std::vector<float>& _coords, uint& _count, Vec3& _low, Vec3& _up, Vec3& _dims);
+	//keeps every _stride-th frame and the closing copy of frame 0. returns the new step count
+	static uint stride(std::vector<float>& _coords, uint _count, uint _stride);
+};
+
+/*
+Runtime configuration. The defaults are the values in Defines.h. They get overridden by
+the config file (key = value per line, # starts a comment) and then by the command line:
+	./mdvis [path] [--config=file] [--key=value ...]
+*/
+struct Config {
+	std::string trajectory;
+	std::string configFile = "mdvis.cfg";
+
+	uint windowWidth = WINDOW_WIDTH;
+	uint windowHeight = WINDOW_HEIGHT;
+	bool binary = USE_BINARY;
+	uint interpolation = INTERPOLATION_TYPE;
+	bool cyclicBoundaries = ENFORCE_CYCLIC_BOUNDARIES;
+	bool splineOnGPU = COMPUTE_SPLINE_ON_GPU;
+	uint sphereSubdivisions = SPHERE_SUBDIVISIONS;
+	bool impostors = SPHERE_IMPOSTORS;
+	bool culling = GPU_CULLING;
+	bool occlusion = OCCLUSION_CULLING;
+	bool compactGBuffer = COMPACT_GBUFFER;
+	bool widget = WIDGET_SHOW;
+	uint widgetWidth = WIDGET_WIDTH;
+	uint widgetHeight = WIDGET_HEIGHT;
+	bool logFrames = LOG_FRAMES;
+	bool ssao = USE_SSAO;
+	uint ssaoKernelSize = SSAO_KERNEL_SIZE;
+	float ssaoRadius = SSAO_RADIUS;
+	float ssaoBias = SSAO_BIAS;
+	uint ssaoScale = SSAO_SCALE;
+	bool ssaoTemporal = SSAO_TEMPORAL;
+	bool atomAO = ATOM_AO;
+	float atomAORadius = ATOM_AO_RADIUS;
+	bool profile = PROFILE_STARTUP;
+	std::string profileReport = PROFILE_REPORT;
+	float taskBudget = TASK_BUDGET_MS;
+	uint uploadSlice = UPLOAD_SLICE_MB;
+	uint cpuBudget = MEMORY_BUDGET_CPU_MB; //0 = unlimited
+	uint gpuBudget = MEMORY_BUDGET_GPU_MB; //0 = what the driver reports, if it does
+	uint threads = CPU_THREADS; //0 = hardware concurrency
+	bool validateSpline = VALIDATE_GPU_SPLINE;
+	bool compactSpline = COMPACT_SPLINE;
+	bool motion = MOTION_CHANNELS;
+
+	bool set(const std::string& _key, const std::string& _value);
+	bool loadFile(const std::string&, bool _required);
+	bool parseArgs(int, char*[]);
+	//clamps everything into its valid range
+	void validate();
+	void print() const;
+	static void usage();
 };
 
 class Logger {
@@ -113,8 +180,118 @@ public:
 	static Logger* get();
 };
 
-#if !USE_SPLINE_SHADER 
+/*
+Collects wall time and processed bytes per loading stage and writes them as json.
+Stages with the same name are accumulated. Thread safe.
+*/
+class Profiler {
+
+	Profiler() {};
+
+	static Profiler* instance;
+
+	struct Stage {
+		std::string name;
+		uint calls = 0;
+		double ms = 0.;
+		size_t bytes = 0;
+	};
+
+	std::mutex mutex;
+	std::vector<Stage> stages;
+	std::chrono::high_resolution_clock::time_point start;
+	uint idleFrames = 0;
+	double idleMs = 0.;
+
+public:
+	class Scope {
+		std::string name;
+		size_t bytes;
+		std::chrono::high_resolution_clock::time_point start;
+	public:
+		Scope(const std::string&, size_t = 0);
+		~Scope();
+		void addBytes(size_t);
+	};
+
+	static void init();
+	static void record(const std::string&, double, size_t);
+	//a frame the render thread spent waiting for the loader
+	static void idleFrame(double);
+	static bool writeReport(const std::string&, const std::string&, uint, uint);
+	static Profiler* get();
+};
+
+/*
+Central registry of the big CPU allocations and GL buffers/textures. Every category keeps
+its current and peak byte count, per pool. Thread safe.
+fit compares the planned footprint of a trajectory against the configured budgets before
+anything big gets allocated and degrades the config until it fits.
+*/
+class Memory {
+
+	Memory() {};
+
+	static Memory* instance;
+
+public:
+	enum Pool { CPU = 0, GPU = 1 };
+
+	struct Footprint {
+		size_t cpu = 0;
+		size_t gpu = 0;
+	};
+
+private:
+	struct Category {
+		std::string name;
+		size_t bytes = 0;
+		size_t peak = 0;
+	};
+
+	std::mutex mutex;
+	std::vector<Category> categories[2];
+	size_t total[2] = {};
+	size_t peak[2] = {};
+
+public:
+	static void alloc(Pool, const std::string&, size_t);
+	static void release(Pool, const std::string&, size_t);
+	static size_t used(Pool);
+	static size_t peakUsage(Pool);
+
+	//footprint of a trajectory with _atoms atoms and _steps steps (incl. the closing frame) loaded with _config
+	static Footprint estimate(const Config& _config, uint _atoms, uint _steps, uint _stride, int _width, int _height);
+	//whether _footprint stays within the budgets of _config, 0 is unlimited
+	static bool fits(const Config& _config, const Footprint& _footprint);
+	/*
+	drops the spline weights (cubic -> catmull-rom) and then doubles the time stride until the estimate fits the budgets. returns the stride.
+	changes _config in place, the loader passes its own copy and publishes the result to the render thread.
+	*/
+	static uint fit(Config& _config, uint _atoms, uint _steps, int _width, int _height);
+
+	static void log();
+	//json array of all categories, used by the profile report
+	static void writeJson(std::ostream&, const std::string& _indent);
+	static Memory* get();
+};
+
 struct SplineBuilder {
-	static void build(uint _count, uint _steps, const Vec3& dims, std::vector<float>& _traj, std::vector<float>& _out);
+	//from the unwrapped trajectory, see Periodic.hpp
+	static void build(uint _count, uint _steps, const std::vector<float>& _traj, std::vector<float>& _out);
+	/*
+	Same on the gpu with t_shader, from the trajectory buffer _traj into _weights (12 floats
+	or, _compact, 6 uints per atom and segment), which has to be allocated. Needs a current
+	gl 4.3 context. With _wait it blocks until the dispatch finished, for timing it.
+	*/
+	static void buildGPU(uint _count, uint _steps, const Vec3& dims, bool _compact, GLuint _traj, GLuint _weights, bool _wait = false);
+	//compact layout of Spline::compact, returns the largest deviation from the float weights
+	static float compact(uint _count, uint _steps, const Vec3& dims, const std::vector<float>& _weights, std::vector<uint>& _out);
+	/*
+	Positions of the atoms [_begin, _end) at every time of _times, see Spline::evaluate.
+	_out[(sample * (_end - _begin) + atom - _begin) * 3 + k]. Samples and blocks of atoms
+	are spread over the ThreadPool. The compact overload always wraps.
+	*/
+	static void evaluate(uint _count, uint _steps, const Vec3& dims, bool _wrap, const std::vector<float>& _weights, const std::vector<float>& _times, uint _begin, uint _end, std::vector<float>& _out);
+	static void evaluate(uint _count, uint _steps, const Vec3& dims, const std::vector<uint>& _weights, const std::vector<float>& _times, uint _begin, uint _end, std::vector<float>& _out);
 };
-#endif // USE_SPLINE_SHADER
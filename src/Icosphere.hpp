@@ -0,0 +1,257 @@
+#pragma once
+
+#include "Defines.h"
+
+/*
+	Compile time generated icospheres. Every subdivision level from 0 to TABLE_SUBDIVISIONS
+	is evaluated by the compiler, including the normal, tangent and bitangent per vertex.
+	Setting up a sphere at runtime is a table lookup.
+
+	The levels above TABLE_SUBDIVISIONS would cost the compiler seconds per translation unit
+	(and run into constexpr step limits), so generate() builds them at runtime from the finest
+	table with the same subdivide and frame code. Icosahedron::get does that once.
+
+	The vertex order is the same as the one the old runtime subdivision produced: a new
+	vertex gets the next free index the first time its edge is visited.
+*/
+namespace Icosphere {
+
+	constexpr uint MAX_SUBDIVISIONS = 5u;
+	constexpr uint TABLE_SUBDIVISIONS = 3u; //SPHERE_SUBDIVISIONS and one level above
+	constexpr uint AUXVERTEXSIZE = 9u; //nrm + t + bt
+
+	constexpr uint vertexCount(uint _level) {
+		return 10u * (1u << (2u * _level)) + 2u;
+	}
+
+	constexpr uint triangleCount(uint _level) {
+		return 20u * (1u << (2u * _level));
+	}
+
+	namespace detail {
+
+		constexpr double sqrt(double _x) {
+			if (_x <= 0.) return 0.;
+			double r = _x > 1. ? _x : 1.;
+			for (int i = 0; i < 64; ++i) {
+				const double n = 0.5 * (r + _x / r);
+				if (n == r) break;
+				r = n;
+			}
+			return r;
+		}
+
+		template<uint L>
+		struct Mesh {
+			static constexpr uint V = vertexCount(L);
+			static constexpr uint T = triangleCount(L);
+			std::array<double, 3 * V> vertices{};
+			std::array<uint, 3 * T> indices{};
+		};
+
+		constexpr Mesh<0> base() {
+			const double X = .525731112119133606;
+			const double Z = .850650808352039932;
+			const double N = 0.;
+
+			Mesh<0> out{};
+			const double v[] = {
+				-X,N,Z, X,N,Z, -X,N,-Z, X,N,-Z,
+				N,Z,X, N,Z,-X, N,-Z,X, N,-Z,-X,
+				Z,X,N, -Z,X,N, Z,-X,N, -Z,-X,N
+			};
+			const uint t[] = {
+				0,4,1, 0,9,4, 9,5,4, 4,5,8, 4,8,1,
+				8,10,1, 8,3,10, 5,3,8, 5,2,3, 2,7,3,
+				7,10,3, 7,6,10, 7,11,6, 11,0,6, 0,1,6,
+				6,1,10, 9,0,11, 9,11,2, 9,2,5, 7,2,11
+			};
+			for (uint i = 0; i < 3 * Mesh<0>::V; ++i) out.vertices[i] = v[i];
+			for (uint i = 0; i < 3 * Mesh<0>::T; ++i) out.indices[i] = t[i];
+			return out;
+		}
+
+		constexpr uint SLOTS = 6u;
+
+		/*
+			Splits every triangle of the given level into 4. The edge lookup stores each edge at
+			its lower vertex, an icosphere vertex has at most 6 neighbours. neighbour and midpoint
+			hold SLOTS entries per input vertex, used one zeroed entry per input vertex.
+		*/
+		constexpr void subdivide(uint _level, const double* _vertices, const uint* _indices, double* _outVertices, uint* _outIndices, uint* _neighbour, uint* _midpoint, uint* _used) {
+			const uint V = vertexCount(_level);
+			const uint T = triangleCount(_level);
+
+			for (uint i = 0; i < 3 * V; ++i)
+				_outVertices[i] = _vertices[i];
+			uint next = V;
+
+			for (uint t = 0; t < T; ++t) {
+				uint mid[3] = {};
+				for (uint e = 0; e < 3; ++e) {
+					const uint first = _indices[3 * t + e];
+					const uint second = _indices[3 * t + (e + 1) % 3];
+					const uint lo = first < second ? first : second;
+					const uint hi = first < second ? second : first;
+
+					uint found = next;
+					for (uint s = 0; s < _used[lo]; ++s)
+						if (_neighbour[lo * SLOTS + s] == hi) found = _midpoint[lo * SLOTS + s];
+
+					if (found == next) {
+						_neighbour[lo * SLOTS + _used[lo]] = hi;
+						_midpoint[lo * SLOTS + _used[lo]] = next;
+						++_used[lo];
+
+						const double x = _outVertices[3 * first] + _outVertices[3 * second];
+						const double y = _outVertices[3 * first + 1] + _outVertices[3 * second + 1];
+						const double z = _outVertices[3 * first + 2] + _outVertices[3 * second + 2];
+						const double l = sqrt(x * x + y * y + z * z);
+						_outVertices[3 * next] = x / l;
+						_outVertices[3 * next + 1] = y / l;
+						_outVertices[3 * next + 2] = z / l;
+						++next;
+					}
+					mid[e] = found;
+				}
+
+				const uint* v = &_indices[3 * t];
+				const uint tris[12] = {
+					v[0], mid[0], mid[2],
+					v[1], mid[1], mid[0],
+					v[2], mid[2], mid[1],
+					mid[0], mid[1], mid[2]
+				};
+				for (uint i = 0; i < 12; ++i)
+					_outIndices[12 * t + i] = tris[i];
+			}
+		}
+
+		template<uint L>
+		constexpr Mesh<L + 1> subdivide(const Mesh<L>& _in) {
+			Mesh<L + 1> out{};
+			std::array<uint, Mesh<L>::V * SLOTS> neighbour{};
+			std::array<uint, Mesh<L>::V * SLOTS> midpoint{};
+			std::array<uint, Mesh<L>::V> used{};
+			subdivide(L, _in.vertices.data(), _in.indices.data(), out.vertices.data(), out.indices.data(), neighbour.data(), midpoint.data(), used.data());
+			return out;
+		}
+
+		/*
+			Normal, tangent and bitangent as the runtime code computed them. The tangent is
+			cross(n, UVY) and falls back to cross(n, UVX) at the poles.
+		*/
+		constexpr void frame(const double* _normal, float* _position, float* _aux) {
+			const double nx = _normal[0];
+			const double ny = _normal[1];
+			const double nz = _normal[2];
+
+			double tx = -nz, ty = 0., tz = nx;
+			if (tx * tx + tz * tz < 1e-12) {
+				tx = 0.; ty = nz; tz = -ny;
+			}
+			const double tl = sqrt(tx * tx + ty * ty + tz * tz);
+			tx /= tl; ty /= tl; tz /= tl;
+
+			double bx = ny * tz - nz * ty;
+			double by = nz * tx - nx * tz;
+			double bz = nx * ty - ny * tx;
+			const double bl = sqrt(bx * bx + by * by + bz * bz);
+			bx /= bl; by /= bl; bz /= bl;
+
+			const double values[AUXVERTEXSIZE] = { nx, ny, nz, tx, ty, tz, bx, by, bz };
+
+			for (uint k = 0; k < 3; ++k)
+				_position[k] = static_cast<float>(values[k]);
+			for (uint k = 0; k < AUXVERTEXSIZE; ++k)
+				_aux[k] = static_cast<float>(values[k]);
+		}
+
+		template<uint L>
+		constexpr Mesh<L> mesh = subdivide(mesh<L - 1>);
+
+		template<>
+		constexpr Mesh<0> mesh<0> = base();
+
+	}
+
+	template<uint L>
+	struct Table {
+		static constexpr uint VERTICES = vertexCount(L);
+		static constexpr uint INDICES = 3 * triangleCount(L);
+		std::array<float, 3 * VERTICES> vertices{};
+		std::array<float, AUXVERTEXSIZE * VERTICES> aux{};
+		std::array<uint, INDICES> indices{};
+	};
+
+	template<uint L>
+	constexpr Table<L> build() {
+		static_assert(L <= TABLE_SUBDIVISIONS, "levels above TABLE_SUBDIVISIONS are built by generate()");
+		const auto& m = detail::mesh<L>;
+		Table<L> out{};
+		for (uint i = 0; i < Table<L>::VERTICES; ++i)
+			detail::frame(&m.vertices[3 * i], &out.vertices[3 * i], &out.aux[AUXVERTEXSIZE * i]);
+		for (uint i = 0; i < Table<L>::INDICES; ++i)
+			out.indices[i] = m.indices[i];
+		return out;
+	}
+
+	template<uint L>
+	constexpr Table<L> table = build<L>();
+
+	/*
+		Runtime view into one of the tables.
+	*/
+	struct Mesh {
+		const float* vertices = nullptr; //pos, 3 floats per vertex
+		const float* aux = nullptr; //nrm + t + bt, AUXVERTEXSIZE floats per vertex
+		const uint* indices = nullptr;
+		uint vertexCount = 0u;
+		uint indexCount = 0u;
+	};
+
+	/*
+		Runtime storage for a level above TABLE_SUBDIVISIONS.
+	*/
+	struct Buffers {
+		std::vector<float> vertices;
+		std::vector<float> aux;
+		std::vector<uint> indices;
+
+		Mesh view() const {
+			return { vertices.data(), aux.data(), indices.data(), static_cast<uint>(vertices.size() / 3), static_cast<uint>(indices.size()) };
+		}
+	};
+
+	/*
+		Subdivides the finest table up to MAX_SUBDIVISIONS on the heap. Entry i is level
+		TABLE_SUBDIVISIONS + 1 + i.
+	*/
+	inline std::vector<Buffers> generate() {
+		const auto& base = detail::mesh<TABLE_SUBDIVISIONS>;
+		std::vector<double> vertices(base.vertices.begin(), base.vertices.end());
+		std::vector<uint> indices(base.indices.begin(), base.indices.end());
+
+		std::vector<Buffers> out;
+		for (uint l = TABLE_SUBDIVISIONS; l < MAX_SUBDIVISIONS; ++l) {
+			std::vector<double> nextVertices(3 * vertexCount(l + 1));
+			std::vector<uint> nextIndices(3 * triangleCount(l + 1));
+			std::vector<uint> neighbour(vertexCount(l) * detail::SLOTS);
+			std::vector<uint> midpoint(vertexCount(l) * detail::SLOTS);
+			std::vector<uint> used(vertexCount(l));
+			detail::subdivide(l, vertices.data(), indices.data(), nextVertices.data(), nextIndices.data(), neighbour.data(), midpoint.data(), used.data());
+			vertices.swap(nextVertices);
+			indices.swap(nextIndices);
+
+			Buffers level;
+			level.vertices.resize(3 * vertexCount(l + 1));
+			level.aux.resize(AUXVERTEXSIZE * vertexCount(l + 1));
+			for (uint i = 0; i < vertexCount(l + 1); ++i)
+				detail::frame(&vertices[3 * i], &level.vertices[3 * i], &level.aux[AUXVERTEXSIZE * i]);
+			level.indices = indices;
+			out.push_back(std::move(level));
+		}
+		return out;
+	}
+
+}
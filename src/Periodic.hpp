@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Defines.h"
+#include "ThreadPool.hpp"
+
+/*
+	Periodic boundary unwrap. Atoms leaving the box come back on the other side; the unwrap
+	moves every frame by the whole boxes its atoms crossed since the first frame, so the
+	trajectory is continuous. The displacement between two frames is taken to its nearest
+	image, which also covers jumps of more than one box (strided trajectories).
+
+	The unwrapped trajectory is what all interpolations read: the compute shaders wrap the
+	interpolated position back into the box, the spline builders need no boundary handling
+	of their own and the raw positions are the unwrapped ones modulo the box.
+
+	Layout as the trajectory: _traj[step * count * 3 + 3 * atom + k]
+*/
+namespace Periodic {
+
+	/*
+		Unwrap state of a run of lanes (3 per atom, x y z interleaved) over consecutive frames,
+		O(lanes) however many frames. The first frame is the reference and stays as it is.
+	*/
+	class Unwrap {
+		std::vector<float> prev; //the last frame as it came in
+		std::vector<float> shift; //images crossed so far
+		std::vector<float> h, ih; //box and inverse box per lane
+		bool first = true;
+
+	public:
+		Unwrap(size_t _lanes, const Vec3& _dims) : prev(_lanes), shift(_lanes, 0.f), h(_lanes), ih(_lanes) {
+			const float box[3] = { _dims.x, _dims.y, _dims.z };
+			for (size_t l = 0; l < _lanes; ++l) {
+				h[l] = box[l % 3];
+				ih[l] = 1.f / h[l];
+			}
+		}
+
+		//unwraps the next frame in place. Branch free over contiguous lanes, so it vectorizes
+		void next(float* _frame) {
+			const size_t lanes = prev.size();
+			if (first) {
+				std::copy(_frame, _frame + lanes, prev.begin());
+				first = false;
+				return;
+			}
+			for (size_t l = 0; l < lanes; ++l) {
+				const float x = _frame[l];
+				const float q = (x - prev[l]) * ih[l];
+				//nearest integer by truncation, half away from zero
+				shift[l] -= static_cast<float>(static_cast<int>(q + (q >= 0.f ? 0.5f : -0.5f)));
+				prev[l] = x;
+				_frame[l] = x + shift[l] * h[l];
+			}
+		}
+	};
+
+	//unwraps the atoms [_begin, _end) of all frames in place. Disjoint atom ranges can run concurrently
+	inline void unwrap(float* _traj, uint _count, uint _steps, const Vec3& _dims, uint _begin, uint _end) {
+		const size_t frame = static_cast<size_t>(_count) * 3;
+		Unwrap state(static_cast<size_t>(_end - _begin) * 3, _dims);
+		for (uint i = 0; i < _steps; ++i)
+			state.next(_traj + i * frame + 3 * static_cast<size_t>(_begin));
+	}
+
+	//unwraps the whole trajectory in place, atom ranges spread over the ThreadPool
+	inline void unwrap(std::vector<float>& _traj, uint _count, const Vec3& _dims) {
+		if (_count == 0) return;
+		const uint steps = static_cast<uint>(_traj.size() / (static_cast<size_t>(_count) * 3));
+		ThreadPool& pool = ThreadPool::get();
+		//a few ranges per thread balance uneven progress, 64 atoms at least keep the rows of a frame in whole cache lines
+		const uint range = std::max(64u, (_count + 4 * pool.size() - 1) / (4 * pool.size()));
+		pool.run((_count + range - 1) / range, [&](uint _chunk, uint) {
+			const uint begin = _chunk * range;
+			unwrap(_traj.data(), _count, steps, _dims, begin, std::min(begin + range, _count));
+		});
+	}
+
+}
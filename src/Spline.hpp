@@ -0,0 +1,486 @@
+#pragma once
+
+#include "Defines.h"
+#include "ThreadPool.hpp"
+#include "Periodic.hpp"
+
+#include <cstring>
+#include <limits>
+
+/*
+	Natural cubic spline through the trajectory of every atom. Segment i of an atom and
+	dimension is
+		p(h) = a + b*h + c*h^2 + d*h^3,		h in [0, t), t = 1/steps
+	where the second derivatives x solve the tridiagonal system
+		m13*x[i-1] + m2*x[i] + m13*x[i+1] = rhs[i].
+
+	The matrix only depends on the number of steps. It is factorized once per trajectory
+	and every atom and dimension is a right hand side of that one factorization, solved
+	row by row for a whole block of atoms at a time so the inner loops run over contiguous
+	memory.
+
+	The influence of a row on the solution falls by 2 - sqrt(3) per row, so the weights of a
+	window of segments only need the frames of the window plus OVERLAP frames on each side:
+	past that the truncation error is below float precision. Windows are independent, which
+	lets SplineBuilder solve them in parallel and Stream build the spline while frames are
+	still arriving, in memory proportional to the window.
+
+	The trajectory is expected unwrapped (Periodic.hpp), the segments follow the atoms
+	across the box boundaries.
+
+	Layouts:
+		trajectory:	_traj[step * count * 3 + 3 * atom + k]
+		weights:	_out[seg * count * 12 + 12 * atom + k + 3 * j], j = a, b, c, d
+*/
+namespace Spline {
+
+	//atoms whose weights are computed together, 48 lanes fill a few AVX2/ AVX-512 registers
+	constexpr uint TILE = 16;
+
+	//frames solved past each side of a window, (2 - sqrt(3))^16 < 2^-30
+	constexpr uint OVERLAP = 16;
+
+	//segments per window
+	constexpr uint WINDOW = 256;
+
+	/*
+		Forward elimination coefficients of the Thomas algorithm. m is the inverse pivot
+		and c the normalized super diagonal of every row. steps sets the parametrization,
+		rows how many rows can be solved at once (a whole trajectory or a window).
+	*/
+	struct Factorization {
+		uint steps = 0;
+		uint rows = 0;
+		float t = 0.f;
+		float m2 = 0.f;
+		float m13 = 0.f;
+		std::vector<float> m;
+		std::vector<float> c;
+
+		Factorization() = default;
+
+		explicit Factorization(uint _steps, uint _rows = 0) : steps(_steps), rows(_rows ? _rows : _steps), m(rows), c(rows) {
+			t = 1.f / float(_steps);
+			m2 = (2.f * t) / 3.f;
+			m13 = t / 6.f;
+
+			m[0] = 1.f / m2;
+			c[0] = m13 * m[0];
+			for (uint i = 1; i < rows; ++i) {
+				m[i] = 1.f / (m2 - m13 * c[i - 1]);
+				c[i] = m13 * m[i];
+			}
+		}
+	};
+
+	/*
+		Forward and back substitution of the first _rows rows for _lanes right hand sides at
+		once. Row i of all lanes is stored contiguously at _x + i * _stride, the solution
+		overwrites it.
+	*/
+	inline void solve(const Factorization& _f, float* _x, uint _rows, size_t _lanes, size_t _stride) {
+		const uint n = _rows;
+		const float m13 = _f.m13;
+
+		float* row = _x;
+		for (size_t l = 0; l < _lanes; ++l)
+			row[l] *= _f.m[0];
+		for (uint i = 1; i < n; ++i) {
+			const float* prev = _x + (i - 1) * _stride;
+			row = _x + i * _stride;
+			const float m = _f.m[i];
+			for (size_t l = 0; l < _lanes; ++l)
+				row[l] = (row[l] - m13 * prev[l]) * m;
+		}
+
+		for (uint i = n - 1; i-- > 0;) {
+			const float* next = _x + (i + 1) * _stride;
+			row = _x + i * _stride;
+			const float c = _f.c[i];
+			for (size_t l = 0; l < _lanes; ++l)
+				row[l] -= c * next[l];
+		}
+	}
+
+	//atoms per block so one block of right hand sides stays in L2
+	inline uint blockSize(uint _rows) {
+		const uint b = (64u * 1024u) / (3u * std::max(_rows, 1u));
+		return std::max(8u, b & ~7u);
+	}
+
+	//rows a window of _window segments solves at most
+	inline uint windowRows(uint _window) {
+		return _window + 1 + 2 * OVERLAP;
+	}
+
+	/*
+		Weights of the segments [_first, _last) of the atoms [_begin, _end) of a trajectory with
+		_frames frames. Only the frames [_first - OVERLAP - 1, _last + OVERLAP + 1] are read, frame i
+		at _traj + (i - _base) * count * 3. The rows at frame 0 and _frames - 1 get the boundary
+		conditions, a window that ends anywhere else is cut off. The last segment holds the
+		closing frame.
+		_x is scratch for windowRows(_last - _first) * 3 * (_end - _begin) floats, segment i is
+		written to _out + (i - _first) * count * 12.
+	*/
+	inline void build(const Factorization& _f, const float* _traj, uint _base, uint _count, uint _frames, uint _first, uint _last, uint _begin, uint _end, float* _x, float* _out) {
+		const uint n = _frames;
+		const uint lo = _first > OVERLAP ? _first - OVERLAP : 0;
+		const uint hi = std::min(n, _last + 1 + OVERLAP);
+		const uint rows = hi - lo;
+		const size_t frame = static_cast<size_t>(_count) * 3;
+		const size_t lanes = static_cast<size_t>(_end - _begin) * 3;
+		const float t = _f.t;
+		const float it = float(_f.steps); //1/t
+		const float* p = _traj + 3 * static_cast<size_t>(_begin);
+		auto at = [&](uint _i) { return p + (_i - _base) * frame; };
+
+		//rhs, the first and last frame get the boundary conditions
+		for (uint i = lo; i < hi; ++i) {
+			float* x = _x + (i - lo) * lanes;
+			if (i == 0) {
+				const float* p0 = at(0);
+				const float* p1 = at(1);
+				for (size_t j = 0; j < lanes; ++j)
+					x[j] = 3.f * (p1[j] - p0[j]) * it;
+			} else if (i == n - 1) {
+				const float* pl = at(n - 2);
+				const float* ph = at(n - 1);
+				for (size_t j = 0; j < lanes; ++j)
+					x[j] = -3.f * (ph[j] - pl[j]) * it;
+			} else {
+				const float* l = at(i - 1);
+				const float* m = at(i);
+				const float* h = at(i + 1);
+				for (size_t j = 0; j < lanes; ++j)
+					x[j] = (h[j] - 2.f * m[j] + l[j]) * it;
+			}
+		}
+
+		solve(_f, _x, rows, lanes, lanes);
+
+		//calc weights. b, c and d of a tile are computed over contiguous lanes, then interleaved
+		const float t6 = t / 6.f;
+		const float it6 = it / 6.f;
+		alignas(64) float tb[3 * TILE], tc[3 * TILE], td[3 * TILE];
+		for (uint i = _first; i < _last; ++i) {
+			const float* l = at(i);
+			float* w = _out + (i - _first) * frame * 4 + 12 * static_cast<size_t>(_begin);
+
+			//the last segment holds the closing frame
+			if (i + 1 >= n) {
+				for (size_t j = 0; j < lanes; j += 3, w += 12) {
+					for (uint k = 0; k < 3; ++k) {
+						w[k] = l[j + k];
+						w[k + 3] = w[k + 6] = w[k + 9] = 0.f;
+					}
+				}
+				continue;
+			}
+
+			const float* m = at(i + 1);
+			const float* xl = _x + (i - lo) * lanes;
+			const float* xh = _x + (i + 1 - lo) * lanes;
+			for (size_t j0 = 0; j0 < lanes; j0 += 3 * TILE) {
+				const size_t len = std::min<size_t>(3 * TILE, lanes - j0);
+				for (size_t j = 0; j < len; ++j) {
+					tb[j] = (m[j0 + j] - l[j0 + j]) * it - t6 * (2.f * xl[j0 + j] + xh[j0 + j]);
+					tc[j] = 0.5f * xl[j0 + j];
+					td[j] = (xh[j0 + j] - xl[j0 + j]) * it6;
+				}
+				for (size_t j = 0; j < len; j += 3, w += 12) {
+					for (uint k = 0; k < 3; ++k) {
+						w[k] = l[j0 + j + k];
+						w[k + 3] = tb[j + k];
+						w[k + 6] = tc[j + k];
+						w[k + 9] = td[j + k];
+					}
+				}
+			}
+		}
+	}
+
+	/*
+		Builds the spline while the frames are still arriving. push unwraps the new frames
+		and, as soon as OVERLAP frames past a window are known, solves the window (atom
+		blocks spread over the ThreadPool) and hands its weights to the sink. finish marks
+		the last pushed frame as the closing frame and flushes the rest. The frames are unwrapped
+		here as they arrive, there is no whole trajectory for Periodic::unwrap. Only the frames the
+		open window still needs are kept, so memory is O(window * atoms) however long the run.
+		steps is the number of frames the whole trajectory will have, it sets t.
+
+		The viewer does not use it yet: FileParser reads the whole file before the memory
+		budget is fitted, and the unwrapped trajectory is uploaded anyway, so load() builds with
+		SplineBuilder. Only mdvis_bench drives a Stream for now.
+	*/
+	class Stream {
+
+	public:
+		//weights of _segments segments starting at segment _first, layout as above
+		using Sink = std::function<void(uint _first, uint _segments, const float* _weights)>;
+
+	private:
+		uint count, steps, window;
+		Sink sink;
+		Factorization factorization;
+		uint block;
+
+		std::vector<float> frames; //frames [base, base + held)
+		uint base = 0, held = 0;
+		uint done = 0; //segments handed to the sink
+
+		Periodic::Unwrap unwrap;
+		std::vector<std::vector<float>> scratch;
+		std::vector<float> out;
+
+		size_t frameSize() const {
+			return static_cast<size_t>(count) * 3;
+		}
+
+		void emit(uint _last, uint _frames) {
+			const uint blocks = (count + block - 1) / block;
+			ThreadPool::get().run(blocks, [&](uint _block, uint _thread) {
+				std::vector<float>& x = scratch[_thread];
+				if (x.empty()) x.resize(static_cast<size_t>(windowRows(window)) * 3 * std::min(block, count));
+				const uint begin = _block * block;
+				build(factorization, frames.data(), base, count, _frames, done, _last, begin, std::min(begin + block, count), x.data(), out.data());
+			});
+			sink(done, _last - done, out.data());
+			done = _last;
+
+			//keep the frames the next window reads
+			const uint keep = done > OVERLAP + 1 ? done - OVERLAP - 1 : 0;
+			if (keep > base) {
+				frames.erase(frames.begin(), frames.begin() + (keep - base) * frameSize());
+				held -= keep - base;
+				base = keep;
+			}
+		}
+
+	public:
+		Stream(uint _count, uint _steps, const Vec3& _dims, Sink _sink, uint _window = WINDOW) :
+			count(_count), steps(_steps), window(_window), sink(std::move(_sink)),
+			factorization(_steps, std::min(_steps, windowRows(_window))), block(blockSize(windowRows(_window))),
+			unwrap(static_cast<size_t>(_count) * 3, _dims), scratch(ThreadPool::get().size()), out(static_cast<size_t>(_window) * _count * 12) {}
+
+		//appends _n frames, unwrapped against the frames before them
+		void push(const float* _frames, uint _n) {
+			const size_t frame = frameSize();
+			for (uint f = 0; f < _n; ++f) {
+				const float* in = _frames + f * frame;
+				frames.insert(frames.end(), in, in + frame);
+				unwrap.next(frames.data() + static_cast<size_t>(held) * frame);
+				++held;
+
+				//a window is final once the frame OVERLAP + 1 past it is known
+				if (base + held >= done + window + OVERLAP + 2)
+					emit(done + window, std::numeric_limits<uint>::max());
+			}
+		}
+
+		//the last pushed frame is the closing frame, solves everything that is left
+		void finish() {
+			const uint n = base + held;
+			if (n == 0) return;
+			while (done < n)
+				emit(std::min(done + window, n), n);
+		}
+	};
+
+	//ieee 754 half float bits, rounded to nearest even
+	inline uint toHalf(float _v) {
+		uint f;
+		std::memcpy(&f, &_v, sizeof(float));
+		const uint sign = (f >> 16) & 0x8000u;
+		const int exp = int((f >> 23) & 0xFFu) - 127 + 15;
+		uint mant = f & 0x7FFFFFu;
+		//inf, nan and overflow
+		if (exp >= 31) return sign | 0x7C00u | ((f & 0x7FFFFFFFu) > 0x7F800000u ? 0x200u : 0u);
+		//subnormal or zero
+		if (exp <= 0) {
+			if (exp < -10) return sign;
+			mant |= 0x800000u;
+			const uint shift = uint(14 - exp);
+			uint h = mant >> shift;
+			const uint rem = mant & ((1u << shift) - 1u);
+			const uint half = 1u << (shift - 1);
+			if (rem > half || (rem == half && (h & 1u))) ++h;
+			return sign | h;
+		}
+		uint h = (uint(exp) << 10) | (mant >> 13);
+		const uint rem = mant & 0x1FFFu;
+		if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;
+		return sign | h;
+	}
+
+	inline float fromHalf(uint _h) {
+		const uint exp = (_h >> 10) & 0x1Fu;
+		const uint mant = _h & 0x3FFu;
+		float v;
+		if (exp == 0) v = std::ldexp(float(mant), -24);
+		else if (exp == 31) v = mant ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+		else v = std::ldexp(float(mant | 0x400u), int(exp) - 25);
+		return _h & 0x8000u ? -v : v;
+	}
+
+	//fromHalf for finite values without branches or subnormal float math, so loops over it vectorize
+	inline float fromHalfFinite(uint _h) {
+		//normal: rebias the exponent, subnormal: mantissa * 2^-24
+		const uint normal = ((_h & 0x7FFFu) << 13) + (112u << 23);
+		const float sub = float(int(_h & 0x3FFu)) * 0x1p-24f;
+		uint subnormal;
+		std::memcpy(&subnormal, &sub, sizeof(float));
+		const uint mask = 0u - uint((_h & 0x7C00u) != 0u);
+		const uint f = (normal & mask) | (subnormal & ~mask) | ((_h & 0x8000u) << 16);
+		float v;
+		std::memcpy(&v, &f, sizeof(float));
+		return v;
+	}
+
+	/*
+		Compact weights, 12 16 bit values in 6 uints per atom and segment (half the size):
+			a:			fixed point fraction of the box, the position wrapped into it
+			B, C, D:	half floats of b*t, c*t^2, d*t^3, the contribution over one whole segment
+		so p(T) = a + ((D*T + C)*T + B)*T with T = h/t in [0, 1). Values are stored in the order
+		a.xyz, B.xyz, C.xyz, D.xyz, two per uint, low half first (GLSL unpackUnorm2x16,
+		unpackHalf2x16).
+			compact:	_out[seg * count * 6 + 6 * atom + i]
+	*/
+	inline uint packedA(float _a, float _dims) {
+		const float f = _a / _dims - std::floor(_a / _dims);
+		return static_cast<uint>(std::lround(std::clamp(f, 0.f, 1.f) * 65535.f));
+	}
+
+	inline float unpackedA(uint _a, float _dims) {
+		return float(_a) / 65535.f * _dims;
+	}
+
+	/*
+		Largest distance between the float weights _w and the compact weights _c of one atom
+		and segment over the start, middle and end of the segment. Taken as the nearest
+		periodic image since a is wrapped.
+	*/
+	inline float deviation(const float* _w, const uint* _c, const float _box[3], float _t) {
+		uint v[12];
+		for (uint i = 0; i < 6; ++i) {
+			v[2 * i] = _c[i] & 0xFFFFu;
+			v[2 * i + 1] = _c[i] >> 16;
+		}
+		float dev = 0.f;
+		for (uint k = 0; k < 3; ++k) {
+			const float a = unpackedA(v[k], _box[k]);
+			const float B = fromHalf(v[3 + k]), C = fromHalf(v[6 + k]), D = fromHalf(v[9 + k]);
+			for (const float T : { 0.f, 0.5f, 1.f }) {
+				const float h = T * _t;
+				const float ref = ((_w[k + 9] * h + _w[k + 6]) * h + _w[k + 3]) * h + _w[k];
+				float d = ((D * T + C) * T + B) * T + a - ref;
+				d -= _box[k] * std::round(d / _box[k]);
+				dev = std::max(dev, std::abs(d));
+			}
+		}
+		return dev;
+	}
+
+	/*
+		Compacts the segments [_begin, _end) of all atoms from _w into _out. Returns the
+		largest deviation from the float weights.
+	*/
+	inline float compact(const float* _w, uint _count, uint _steps, const Vec3& _dims, uint _begin, uint _end, uint* _out) {
+		const float t = 1.f / float(_steps);
+		const float scale[4] = { 1.f, t, t * t, t * t * t };
+		const float box[3] = { _dims.x, _dims.y, _dims.z };
+		float dev = 0.f;
+		for (size_t seg = _begin; seg < _end; ++seg) {
+			for (size_t atom = 0; atom < _count; ++atom) {
+				const float* w = _w + seg * _count * 12 + 12 * atom;
+				uint* o = _out + seg * _count * 6 + 6 * atom;
+				uint v[12];
+				for (uint k = 0; k < 3; ++k) {
+					v[k] = packedA(w[k], box[k]);
+					for (uint j = 1; j < 4; ++j)
+						v[3 * j + k] = toHalf(w[3 * j + k] * scale[j]);
+				}
+				for (uint i = 0; i < 6; ++i)
+					o[i] = v[2 * i] | (v[2 * i + 1] << 16);
+				dev = std::max(dev, deviation(w, o, box, t));
+			}
+		}
+		return dev;
+	}
+
+	//largest deviation of compact weights from the float weights of the same trajectory
+	inline float maxDeviation(const float* _w, const uint* _c, uint _count, uint _steps, const Vec3& _dims) {
+		const float box[3] = { _dims.x, _dims.y, _dims.z };
+		const size_t size = static_cast<size_t>(_count) * _steps;
+		float dev = 0.f;
+		for (size_t i = 0; i < size; ++i)
+			dev = std::max(dev, deviation(_w + 12 * i, _c + 6 * i, box, 1.f / float(_steps)));
+		return dev;
+	}
+
+	/*
+		Largest distance between two sets of weights of the same trajectory, evaluated in the
+		middle of every segment. Used to check the gpu builder against this one.
+	*/
+	inline float maxDeviation(const float* _a, const float* _b, uint _count, uint _steps) {
+		const float h = 0.5f / float(_steps);
+		const size_t size = 12 * static_cast<size_t>(_count) * _steps;
+		float dev = 0.f;
+		for (size_t o = 0; o < size; o += 12) {
+			for (uint k = 0; k < 3; ++k) {
+				const float a = ((_a[o + k + 9] * h + _a[o + k + 6]) * h + _a[o + k + 3]) * h + _a[o + k];
+				const float b = ((_b[o + k + 9] * h + _b[o + k + 6]) * h + _b[o + k + 3]) * h + _b[o + k];
+				dev = std::max(dev, std::abs(a - b));
+			}
+		}
+		return dev;
+	}
+
+	/*
+		Positions of the atoms [_begin, _end) at time _t in [0, 1), the way the compute shader
+		draws them: segment _t * steps, Horner in the time since its start, wrapped into the
+		box with _wrap. The atoms of a segment are contiguous and the loop runs across them, so
+		it vectorizes.
+			_out[3 * (atom - _begin) + k]
+	*/
+	inline void evaluate(const float* _w, uint _count, uint _steps, float _t, const Vec3& _dims, bool _wrap, uint _begin, uint _end, float* _out) {
+		const uint seg = static_cast<uint>(float(_steps) * _t) % _steps;
+		const float h = _t - float(seg) / float(_steps);
+		const float box[3] = { _dims.x, _dims.y, _dims.z };
+		const float inv[3] = { 1.f / _dims.x, 1.f / _dims.y, 1.f / _dims.z };
+		const float* w = _w + static_cast<size_t>(seg) * _count * 12;
+		for (size_t atom = _begin; atom < _end; ++atom) {
+			const float* a = w + 12 * atom;
+			float* o = _out + 3 * (atom - _begin);
+			for (uint k = 0; k < 3; ++k) {
+				float p = ((a[k + 9] * h + a[k + 6]) * h + a[k + 3]) * h + a[k];
+				if (_wrap) p -= box[k] * std::floor(p * inv[k]);
+				o[k] = p;
+			}
+		}
+	}
+
+	//evaluate for compact weights, always wrapped since a is
+	inline void evaluate(const uint* _c, uint _count, uint _steps, float _t, const Vec3& _dims, uint _begin, uint _end, float* _out) {
+		const uint seg = static_cast<uint>(float(_steps) * _t) % _steps;
+		const float T = _t * float(_steps) - float(seg);
+		const float box[3] = { _dims.x, _dims.y, _dims.z };
+		const float inv[3] = { 1.f / _dims.x, 1.f / _dims.y, 1.f / _dims.z };
+		const uint* c = _c + static_cast<size_t>(seg) * _count * 6;
+		for (size_t atom = _begin; atom < _end; ++atom) {
+			const uint* a = c + 6 * atom;
+			float* o = _out + 3 * (atom - _begin);
+			uint v[12];
+			for (uint i = 0; i < 6; ++i) {
+				v[2 * i] = a[i] & 0xFFFFu;
+				v[2 * i + 1] = a[i] >> 16;
+			}
+			for (uint k = 0; k < 3; ++k) {
+				const float B = fromHalfFinite(v[3 + k]), C = fromHalfFinite(v[6 + k]), D = fromHalfFinite(v[9 + k]);
+				float p = ((D * T + C) * T + B) * T + float(int(v[k])) * (box[k] / 65535.f);
+				p -= box[k] * std::floor(p * inv[k]);
+				o[k] = p;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Defines.h"
+
+/*
+	Multi producer, single consumer queue for the GL tasks (intrusive node queue after
+	D. Vyukov). push never blocks and may be called from any thread, tryPop and drain only
+	from the render thread. A producer that was preempted between its two stores leaves
+	the queue looking empty for a moment; the consumer just picks the task up next frame.
+
+	Every task carries its enqueue time, so the consumer can report how long tasks waited
+	(latency) and ran, and how deep the queue got.
+*/
+template<class T>
+class TaskQueue {
+
+public:
+	struct Stats {
+		size_t tasks = 0;
+		size_t frames = 0; //frames that ran at least one task
+		size_t overBudget = 0; //tasks that alone took longer than the budget
+		size_t maxDepth = 0;
+		double totalLatencyMs = 0., maxLatencyMs = 0.;
+		double totalRunMs = 0., maxRunMs = 0.;
+	};
+
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Node {
+		std::atomic<Node*> next{ nullptr };
+		T value;
+		Clock::time_point enqueued;
+	};
+
+	std::atomic<Node*> head; //producers
+	Node* tail; //consumer
+	Node stub;
+
+	std::atomic<size_t> depth{ 0 };
+	std::atomic<size_t> maxDepth{ 0 };
+	Stats stats; //consumer only
+
+	void link(Node* _node) {
+		_node->next.store(nullptr, std::memory_order_relaxed);
+		Node* prev = head.exchange(_node, std::memory_order_acq_rel);
+		prev->next.store(_node, std::memory_order_release);
+	}
+
+	Node* unlink() {
+		Node* t = tail;
+		Node* next = t->next.load(std::memory_order_acquire);
+		if (t == &stub) {
+			if (!next) return nullptr;
+			tail = next;
+			t = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next) {
+			tail = next;
+			return t;
+		}
+		//t is the last node, unless a producer is halfway through linking a new one
+		if (t != head.load(std::memory_order_acquire)) return nullptr;
+		link(&stub);
+		next = t->next.load(std::memory_order_acquire);
+		if (next) {
+			tail = next;
+			return t;
+		}
+		return nullptr;
+	}
+
+public:
+	TaskQueue() : head(&stub), tail(&stub) {}
+
+	~TaskQueue() {
+		while (Node* n = unlink())
+			delete n;
+	}
+
+	TaskQueue(const TaskQueue&) = delete;
+	TaskQueue& operator=(const TaskQueue&) = delete;
+
+	void push(T _value) {
+		Node* n = new Node();
+		n->value = std::move(_value);
+		n->enqueued = Clock::now();
+		const size_t d = depth.fetch_add(1, std::memory_order_relaxed) + 1;
+		size_t m = maxDepth.load(std::memory_order_relaxed);
+		while (d > m && !maxDepth.compare_exchange_weak(m, d, std::memory_order_relaxed));
+		link(n);
+	}
+
+	//consumer only
+	bool tryPop(T& _out) {
+		Node* n = unlink();
+		if (!n) return false;
+		depth.fetch_sub(1, std::memory_order_relaxed);
+		const double latency = std::chrono::duration<double, std::milli>(Clock::now() - n->enqueued).count();
+		stats.totalLatencyMs += latency;
+		stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency);
+		_out = std::move(n->value);
+		delete n;
+		return true;
+	}
+
+	/*
+		Runs tasks with _run until the queue is empty or _budgetMs is used up. At least one
+		task runs per call so the queue always makes progress. Consumer only.
+		Returns the number of tasks run.
+	*/
+	template<class F>
+	size_t drain(double _budgetMs, F&& _run) {
+		const Clock::time_point start = Clock::now();
+		size_t count = 0;
+		T task;
+		while (tryPop(task)) {
+			const Clock::time_point taskStart = Clock::now();
+			_run(task);
+			const Clock::time_point taskEnd = Clock::now();
+			const double ms = std::chrono::duration<double, std::milli>(taskEnd - taskStart).count();
+			stats.totalRunMs += ms;
+			stats.maxRunMs = std::max(stats.maxRunMs, ms);
+			if (ms > _budgetMs) ++stats.overBudget;
+			++count;
+			if (std::chrono::duration<double, std::milli>(taskEnd - start).count() >= _budgetMs) break;
+		}
+		stats.tasks += count;
+		if (count) ++stats.frames;
+		return count;
+	}
+
+	//approximate while producers are active
+	size_t size() const {
+		return depth.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	//consumer only
+	Stats statistics() const {
+		Stats s = stats;
+		s.maxDepth = maxDepth.load(std::memory_order_relaxed);
+		return s;
+	}
+
+};
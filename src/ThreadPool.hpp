@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Defines.h"
+
+#include <condition_variable>
+
+/*
+	Fixed set of worker threads for the CPU heavy loading work (spline build, unwrap).
+	run splits a job into chunks that the workers and the calling thread pull from a shared
+	counter, so uneven chunks balance themselves. Every chunk gets the index of the thread
+	running it, which lets callers keep preallocated scratch per thread.
+
+	One job runs at a time, concurrent calls to run are serialized.
+*/
+class ThreadPool {
+
+	static inline std::unique_ptr<ThreadPool> instance;
+
+	std::vector<std::thread> workers;
+
+	std::mutex runMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	const std::function<void(uint, uint)>* job = nullptr;
+	uint chunks = 0;
+	std::atomic<uint> next{ 0 };
+	uint active = 0;
+	uint generation = 0;
+	bool stop = false;
+
+	void work(uint _thread) {
+		for (uint c = next.fetch_add(1); c < chunks; c = next.fetch_add(1))
+			(*job)(c, _thread);
+	}
+
+	void loop(uint _thread) {
+		uint seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&]() { return stop || generation != seen; });
+				if (stop) return;
+				seen = generation;
+			}
+			work(_thread);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--active == 0) finished.notify_one();
+			}
+		}
+	}
+
+public:
+	//_threads includes the calling thread. 0 = one per hardware thread
+	explicit ThreadPool(uint _threads = 0) {
+		if (_threads == 0) _threads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint i = 1; i < _threads; ++i)
+			workers.emplace_back(&ThreadPool::loop, this, i);
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (std::thread& w : workers)
+			w.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//number of threads running chunks, thread indices are [0, size())
+	uint size() const {
+		return static_cast<uint>(workers.size()) + 1;
+	}
+
+	/*
+		Runs _fn(chunk, thread) for every chunk in [0, _chunks) and returns once all are done.
+		The calling thread works as thread 0.
+	*/
+	void run(uint _chunks, const std::function<void(uint, uint)>& _fn) {
+		if (_chunks == 0) return;
+		std::lock_guard<std::mutex> serial(runMutex);
+		if (workers.empty() || _chunks == 1) {
+			for (uint c = 0; c < _chunks; ++c)
+				_fn(c, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &_fn;
+			chunks = _chunks;
+			next.store(0);
+			active = static_cast<uint>(workers.size());
+			++generation;
+		}
+		wake.notify_all();
+		work(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]() { return active == 0; });
+		job = nullptr;
+	}
+
+	//creates the shared pool, call once before the first get. 0 = one thread per hardware thread
+	static void init(uint _threads) {
+		instance = std::make_unique<ThreadPool>(_threads);
+	}
+
+	static ThreadPool& get() {
+		if (!instance) init(0);
+		return *instance;
+	}
+
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Defines.h"
+#include "ThreadPool.hpp"
+
+/*
+	Trajectory storage in one of three layouts, converted when a consumer asks for another:
+		frames:	_data[(step * count + atom) * 3 + k]					parsers, upload, gpu
+		atoms:	_data[(atom * steps + step) * 3 + k]					time series of one atom
+		tiles:	_data[((tile * steps + step) * 3 + k) * TILE + lane]	atom = tile * TILE + lane
+	tiles is AoSoA: per step a tile of atoms holds one SIMD register per coordinate, and the
+	steps of a tile follow each other, so per atom kernels stream through memory with full
+	vectors. The last tile is padded with zeros.
+
+	frames <-> atoms is a transpose of the steps x atoms matrix of xyz triples, done cache
+	oblivious: the larger side is halved until a block fits in L1, whatever the cache sizes.
+	frames <-> tiles only regroups each frame row. Both run on the ThreadPool over disjoint
+	output ranges. Other conversions go through frames.
+*/
+class Trajectory {
+
+public:
+	enum class Layout { frames, atoms, tiles };
+
+	static constexpr uint TILE = 16;
+
+private:
+	std::vector<float> values;
+	uint atomCount = 0, stepCount = 0;
+	Layout current = Layout::frames;
+
+	//xyz triples per block at the leaves of the transpose, 12 KB read and 12 KB written
+	static constexpr size_t LEAF = 32 * 32;
+
+	//_dst = transpose of the _rows x _cols matrix _src, for the block [_r0, _r1) x [_c0, _c1)
+	static void transpose(const float* _src, float* _dst, size_t _rows, size_t _cols, size_t _r0, size_t _r1, size_t _c0, size_t _c1) {
+		if ((_r1 - _r0) * (_c1 - _c0) <= LEAF) {
+			for (size_t r = _r0; r < _r1; ++r)
+				for (size_t c = _c0; c < _c1; ++c)
+					for (uint k = 0; k < 3; ++k)
+						_dst[(c * _rows + r) * 3 + k] = _src[(r * _cols + c) * 3 + k];
+			return;
+		}
+		if (_r1 - _r0 >= _c1 - _c0) {
+			const size_t m = (_r0 + _r1) / 2;
+			transpose(_src, _dst, _rows, _cols, _r0, m, _c0, _c1);
+			transpose(_src, _dst, _rows, _cols, m, _r1, _c0, _c1);
+		} else {
+			const size_t m = (_c0 + _c1) / 2;
+			transpose(_src, _dst, _rows, _cols, _r0, _r1, _c0, m);
+			transpose(_src, _dst, _rows, _cols, _r0, _r1, m, _c1);
+		}
+	}
+
+	//parallel over column ranges, every task writes its own rows of _dst
+	static void transpose(const float* _src, float* _dst, size_t _rows, size_t _cols) {
+		ThreadPool& pool = ThreadPool::get();
+		const size_t range = std::max<size_t>(32, (_cols + 4 * pool.size() - 1) / (4 * pool.size()));
+		pool.run(static_cast<uint>((_cols + range - 1) / range), [&](uint _chunk, uint) {
+			const size_t c0 = _chunk * range;
+			transpose(_src, _dst, _rows, _cols, 0, _rows, c0, std::min(c0 + range, _cols));
+		});
+	}
+
+	uint tiles() const {
+		return (atomCount + TILE - 1) / TILE;
+	}
+
+	void toFrames() {
+		if (current == Layout::frames) return;
+		std::vector<float> out(static_cast<size_t>(atomCount) * stepCount * 3);
+		if (current == Layout::atoms)
+			transpose(values.data(), out.data(), atomCount, stepCount);
+		else {
+			ThreadPool::get().run(tiles(), [&](uint _tile, uint) {
+				const uint lanes = std::min(TILE, atomCount - _tile * TILE);
+				for (size_t s = 0; s < stepCount; ++s) {
+					const float* in = values.data() + (static_cast<size_t>(_tile) * stepCount + s) * 3 * TILE;
+					float* o = out.data() + (s * atomCount + static_cast<size_t>(_tile) * TILE) * 3;
+					for (uint l = 0; l < lanes; ++l)
+						for (uint k = 0; k < 3; ++k)
+							o[3 * l + k] = in[k * TILE + l];
+				}
+			});
+		}
+		values.swap(out);
+		current = Layout::frames;
+	}
+
+	void fromFrames(Layout _layout) {
+		if (_layout == Layout::frames) return;
+		std::vector<float> out;
+		if (_layout == Layout::atoms) {
+			out.resize(values.size());
+			transpose(values.data(), out.data(), stepCount, atomCount);
+		} else {
+			out.assign(static_cast<size_t>(tiles()) * TILE * stepCount * 3, 0.f);
+			ThreadPool::get().run(tiles(), [&](uint _tile, uint) {
+				const uint lanes = std::min(TILE, atomCount - _tile * TILE);
+				for (size_t s = 0; s < stepCount; ++s) {
+					const float* in = values.data() + (s * atomCount + static_cast<size_t>(_tile) * TILE) * 3;
+					float* o = out.data() + (static_cast<size_t>(_tile) * stepCount + s) * 3 * TILE;
+					for (uint l = 0; l < lanes; ++l)
+						for (uint k = 0; k < 3; ++k)
+							o[k * TILE + l] = in[3 * l + k];
+				}
+			});
+		}
+		values.swap(out);
+		current = _layout;
+	}
+
+public:
+	Trajectory() = default;
+
+	//takes frame major data as the parsers write it
+	Trajectory(std::vector<float>&& _frames, uint _count) : values(std::move(_frames)), atomCount(_count),
+		stepCount(_count ? static_cast<uint>(values.size() / (static_cast<size_t>(_count) * 3)) : 0) {}
+
+	uint count() const { return atomCount; }
+	uint steps() const { return stepCount; }
+	Layout layout() const { return current; }
+
+	//the data in the current layout
+	std::vector<float>& data() { return values; }
+	const std::vector<float>& data() const { return values; }
+
+	//converts to _layout if the data is not in it already
+	void convert(Layout _layout) {
+		if (_layout == current) return;
+		toFrames();
+		fromFrames(_layout);
+	}
+
+	//position of coordinate _k of _atom at _step in the current layout
+	size_t index(uint _step, uint _atom, uint _k) const {
+		switch (current) {
+			case Layout::atoms: return (static_cast<size_t>(_atom) * stepCount + _step) * 3 + _k;
+			case Layout::tiles: return ((static_cast<size_t>(_atom / TILE) * stepCount + _step) * 3 + _k) * TILE + _atom % TILE;
+			default: return (static_cast<size_t>(_step) * atomCount + _atom) * 3 + _k;
+		}
+	}
+
+	//hands the data back in _layout, the store is empty afterwards
+	std::vector<float> release(Layout _layout = Layout::frames) {
+		convert(_layout);
+		std::vector<float> out;
+		out.swap(values);
+		atomCount = stepCount = 0;
+		current = Layout::frames;
+		return out;
+	}
+
+};
@@ -1,5 +1,9 @@
 
 #include "GL.h"
+#include "TaskQueue.hpp"
+#include "ThreadPool.hpp"
+#include "Spline.hpp"
+#include "Periodic.hpp"
 
 #include "xoshiro.h"
 #include "OBJ_Loader.h"
@@ -14,8 +18,11 @@ void GLAPIENTRY MessageCallback(GLenum /*source*/, GLenum type, GLuint /*id*/, G
 #endif
 
 struct Proxy {
+	// -------------------- Config --------------------
+	Config config;
+
 	// -------------------- File --------------------
-	std::string pathToFile;
+	std::string loadedFile;
 
 	// -------------------- States --------------------
 	GLFWwindow* window;
@@ -37,119 +44,403 @@ struct Proxy {
 
 	// -------------------- Constants --------------------
 	uint ATOMCOUNT, TIMESTEPS, SPHEREVERTICES, INDEXCOUNT;
+	uint LODS = 1; //sphere levels drawn, > 1 with culling only
 	const uint VERTEXSIZE = 3u; //pos
 	const uint SPHEREVERTEXSIZE = 3u; //pos
-	const uint AUXVERTEXSIZE = 3u + 3u + 3u; //nrm + t + bt
-	GLint maxIndices;
+	const uint AUXVERTEXSIZE = Icosphere::AUXVERTEXSIZE; //nrm + t + bt
 
 	// -------------------- GL --------------------
 	//expects normalized rgb color. use this tool https://www.tydac.ch/color/
 	Vec4 clearColor = Vec4(0.03f, 0.09f, 0.22f, 1.f); 
 	Vec4 atomColor = Vec4(0.09f, 0.35f, 0.12f, 1.f);
+	float atomRadius = 0.05f;
 	bool isGLloaded = false, shouldTerminate = false;
+	bool loadReported = false; //the render loop logs the task stats once the last load task has run
 
 	//shaders
-	ShaderProgram splineShader, compShader, geomShader, lightShader, widgetShader, ssaoShader, ssaoBlurShader, fxaaShader;
+	ShaderProgram splineShader, geomShader, lightShader, widgetShader, ssaoShader, ssaoBlurShader, fxaaShader;
 
-	//compute pass
-	GLuint c_ssbo_traj, c_ssbo_sphere, cg_vbo, c_ssbo_weights;
+	//compute pass, one program per interpolation so it can be switched while running
+	ShaderProgram compShaders[4];
+	GLuint c_ssbo_traj, cg_vbo, c_ssbo_weights = 0, c_ssbo_motion = 0;
 
 	//geometry pass
-	GLuint g_vao, g_fb, g_pos, g_nrm, g_t, g_bt, g_col, g_depth, g_vbo_aux, g_ebo;
+	GLuint g_vao, g_fb, g_pos, g_nrm, g_t, g_bt, g_col, g_depth, g_vbo_sphere, g_vbo_aux, g_ebo;
+
+	//culling, between the compute and the geometry pass
+	ShaderProgram cullShader, hizShader;
+	GLuint c_ssbo_visible = 0, g_indirect = 0;
+	std::vector<uint> drawCommands; //per LOD (and occlusion phase), instanceCount zeroed. Reset every frame before culling
+	GLuint c_ssbo_visibility = 0, g_hiz = 0; //occlusion culling: visible last frame per atom, depth pyramid
+	int hizLevels = 1;
+
+	//object space ao: uniform grid over the centres rebuilt every frame, one occlusion per atom
+	ShaderProgram aoShaders[4]; //count, scan, scatter, occlusion
+	GLuint a_ssbo_count = 0, a_ssbo_start = 0, a_ssbo_cell = 0, a_ssbo_sorted = 0, a_ssbo_ao = 0, c_ssbo_visible_ao = 0;
+	int aoCells[3] = { 1, 1, 1 };
+	Vec3 aoInvCell = Vec3(0.f);
 
 	//light pass
 	std::vector<float> lights;
 	GLuint l_vao;
 
-#if USE_SSAO
 	//ssao
 	GLuint s_rand, s_fb, s_ssao, ss_b_fb, ss_b_tex, s_samples;
-	Vec2 s_bounds;
-#endif
+	Vec2 s_bounds; //size of the ssao target, the window divided by ssaoScale
+	//reduced resolution ssao: downsampled view z, blur between the two directions, upsampled into ss_b_tex
+	ShaderProgram ssaoDepthShader, ssaoBilateralShader, ssaoUpsampleShader;
+	GLuint s_depth_fb = 0, s_depth = 0, s_blur_fb = 0, s_blur = 0;
+	//temporal ssao: kernel and noise drawn from two non overlapping streams every frame, histories written in turn
+	ShaderProgram ssaoTemporalShader;
+	xoshiro_256 s_kernelStream, s_noiseStream;
+	GLuint s_history[2] = { 0, 0 }, s_history_fb[2] = { 0, 0 };
+	uint s_frame = 0;
+	Mat4 s_prevViewProj = Mat4(1.f);
+
+	//interpolation drawn and the one asked for, they differ while the spline weights are built in the background
+	uint interpolation = 0, requestedInterpolation = 0;
+	enum class Weights { none, building, ready } splineWeights = Weights::none;
+	std::thread splineThread;
+
+	//the frame passes, specialized for the configuration once loading is done
+	void (*draw)(Proxy&) = nullptr;
 
 	//forward pass
 	GLuint widget_vao;
 
 	// -------------------- Data --------------------
-	std::vector<float> coords, weights, sphere_vertices, auxBuffer;
-	std::vector<uint> sphere_indices;
+	std::vector<float> coords, weights;
+	std::vector<uint> compactWeights;
+	Icosphere::Mesh sphere;
 
 	// -------------------- Queue --------------------
-	std::mutex mutex;
-	std::queue<std::function<void(Proxy*)>> asyncQueue;
+	//filled by the loader thread, drained by the render thread within config.taskBudget per frame
+	TaskQueue<std::function<void(Proxy*)>> tasks;
 };
 
+/*
+	Queues the upload of _bytes from _data into a new buffer as one allocation followed by
+	slices of at most config.uploadSlice MB, so a big buffer is spread over several frames
+	instead of stalling one. _data has to stay valid until the last slice ran. The buffer is
+	accounted to _category in the gpu pool.
+*/
+void uploadSliced(Proxy& _proxy, GLuint* _buffer, GLenum _target, const void* _data, size_t _bytes, const std::string& _category) {
+	_proxy.tasks.push([_buffer, _target, _bytes, _category](Proxy* /*_proxy*/)->void {
+		Memory::alloc(Memory::GPU, _category, _bytes);
+		glGenBuffers(1, _buffer);
+		glBindBuffer(_target, *_buffer);
+		glBufferData(_target, _bytes, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(_target, 0);
+	});
+
+	const size_t slice = static_cast<size_t>(std::max(1u, _proxy.config.uploadSlice)) << 20;
+	for (size_t offset = 0; offset < _bytes; offset += slice) {
+		const size_t size = std::min(slice, _bytes - offset);
+		const char* src = static_cast<const char*>(_data) + offset;
+		_proxy.tasks.push([_buffer, _target, src, offset, size](Proxy* /*_proxy*/)->void {
+			Profiler::Scope scope("upload", size);
+			glBindBuffer(_target, *_buffer);
+			glBufferSubData(_target, offset, size, src);
+			glBindBuffer(_target, 0);
+		});
+	}
+}
+
+//video memory currently available in MB if the driver tells, 0 otherwise. Other applications may hold part of the dedicated memory
+uint queryVideoMemory() {
+	GLint kb[4] = {};
+	if (glfwExtensionSupported("GL_NVX_gpu_memory_info"))
+		glGetIntegerv(0x9049, kb); //GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+	else if (glfwExtensionSupported("GL_ATI_meminfo"))
+		glGetIntegerv(0x87FC, kb); //GL_TEXTURE_FREE_MEMORY_ATI, free pool first
+	return static_cast<uint>(std::max(kb[0], 0) / 1024);
+}
+
+//render thread, once the spline weights are on the gpu. Switches to them if cubic interpolation is still asked for
+void onSplineReady(Proxy& _proxy) {
+	_proxy.splineWeights = Proxy::Weights::ready;
+	if (_proxy.requestedInterpolation == 2 && _proxy.interpolation != 2) {
+		_proxy.interpolation = 2;
+		Logger::LOG("LOG:\tInterpolation: cubic spline", true);
+	}
+}
+
+/*
+	Builds the spline weights from the trajectory buffer with t_shader. Runs on the render
+	thread, as a loading task or when cubic interpolation is first selected.
+*/
+void buildSplineGPU(Proxy& _proxy) {
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+	const bool compact = _proxy.config.compactSpline;
+	const size_t weightsSize = static_cast<size_t>(_proxy.ATOMCOUNT) * (compact ? 6 : 12) * sizeof(float) * _proxy.TIMESTEPS;
+	glGenBuffers(1, &_proxy.c_ssbo_weights);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy.c_ssbo_weights);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, weightsSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	Memory::alloc(Memory::GPU, "spline weights", weightsSize);
+
+	{
+		Profiler::Scope scope("spline_gpu", static_cast<size_t>(_proxy.ATOMCOUNT) * _proxy.TIMESTEPS * 3 * sizeof(float));
+		//the scope only measures the dispatch when profiling waits for it
+		SplineBuilder::buildGPU(_proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.dims, compact, _proxy.c_ssbo_traj, _proxy.c_ssbo_weights, _proxy.config.profile);
+	}
+
+	if (_proxy.config.validateSpline) {
+		std::vector<float> gpu(weightsSize / sizeof(float)), cpu;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy.c_ssbo_weights);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, weightsSize, gpu.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		std::vector<float> traj(_proxy.coords);
+		//after loading only the gpu has the trajectory
+		if (traj.empty()) {
+			traj.resize(static_cast<size_t>(_proxy.ATOMCOUNT) * 3 * _proxy.TIMESTEPS);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy.c_ssbo_traj);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, traj.size() * sizeof(float), traj.data());
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+		SplineBuilder::build(_proxy.ATOMCOUNT, _proxy.TIMESTEPS, traj, cpu);
+		//compact weights are compared to the float32 weights of the cpu builder
+		const float deviation = compact ? Spline::maxDeviation(cpu.data(), reinterpret_cast<const uint*>(gpu.data()), _proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.dims) :
+			Spline::maxDeviation(gpu.data(), cpu.data(), _proxy.ATOMCOUNT, _proxy.TIMESTEPS);
+		Logger::LOG("LOG:\tGPU spline vs cpu builder: max deviation " + std::to_string(deviation), true);
+	}
+	Logger::LOG("LOG:\tSpline interpolated.\n", true);
+
+	onSplineReady(_proxy);
+}
+
+/*
+	Builds the spline weights from _proxy.coords on the cpu and queues their upload. Runs on
+	the loader thread, or on _proxy.splineThread when cubic interpolation is first selected
+	after loading. The cpu copies are dropped once the upload ran.
+*/
+void buildSplineCPU(Proxy& _proxy) {
+	{
+		Profiler::Scope scope("spline_cpu", _proxy.coords.size() * sizeof(float));
+		SplineBuilder::build(_proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.coords, _proxy.weights);
+	}
+	Memory::alloc(Memory::CPU, "spline weights", _proxy.weights.size() * sizeof(float));
+	if (_proxy.config.compactSpline) {
+		float deviation;
+		{
+			Profiler::Scope scope("spline_compact", _proxy.weights.size() * sizeof(float));
+			deviation = SplineBuilder::compact(_proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.dims, _proxy.weights, _proxy.compactWeights);
+		}
+		Memory::alloc(Memory::CPU, "spline weights", _proxy.compactWeights.size() * sizeof(uint));
+		Memory::release(Memory::CPU, "spline weights", _proxy.weights.size() * sizeof(float));
+		_proxy.weights.clear();
+		_proxy.weights.shrink_to_fit();
+		Logger::LOG("LOG:\tCompact spline weights, max deviation from float32: " + std::to_string(deviation), true);
+		uploadSliced(_proxy, &_proxy.c_ssbo_weights, GL_SHADER_STORAGE_BUFFER, _proxy.compactWeights.data(), _proxy.compactWeights.size() * sizeof(uint), "spline weights");
+	} else
+		uploadSliced(_proxy, &_proxy.c_ssbo_weights, GL_SHADER_STORAGE_BUFFER, _proxy.weights.data(), _proxy.weights.size() * sizeof(float), "spline weights");
+	Logger::LOG("LOG:\tSpline interpolated.\n", true);
+
+	_proxy.tasks.push([](Proxy* _proxy)->void {
+		for (std::vector<float>* v : { &_proxy->coords, &_proxy->weights }) {
+			v->clear();
+			v->shrink_to_fit();
+		}
+		_proxy->compactWeights.clear();
+		_proxy->compactWeights.shrink_to_fit();
+		for (const char* category : { "trajectory", "spline weights" })
+			Memory::release(Memory::CPU, category, std::numeric_limits<size_t>::max());
+		onSplineReady(*_proxy);
+	});
+}
+
+/*
+	Render thread. Switches the interpolation drawn. The spline weights are only built when
+	cubic interpolation is first asked for, until they are ready the current one stays. If
+	they would not fit the memory budget it falls back to Catmull-Rom like Memory::fit.
+*/
+void setInterpolation(Proxy& _proxy, uint _mode) {
+	const char* names[] = { "none", "linear", "cubic spline", "Catmull-Rom" };
+	if (_mode == 2 && _proxy.TIMESTEPS > 1 && _proxy.splineWeights == Proxy::Weights::none) {
+		//the trajectory is already strided, the estimate takes the loaded steps as they are
+		Config cubic = _proxy.config;
+		cubic.interpolation = 2;
+		if (!Memory::fits(cubic, Memory::estimate(cubic, _proxy.ATOMCOUNT, _proxy.TIMESTEPS, 1, _proxy.wWidth, _proxy.wHeight))) {
+			Logger::LOG("WARNING:\tOver memory budget. Using Catmull-Rom interpolation, no spline weights", true);
+			_mode = 3;
+		}
+	}
+	_proxy.requestedInterpolation = _mode;
+	if (_mode == 2 && _proxy.TIMESTEPS > 1 && _proxy.splineWeights != Proxy::Weights::ready) {
+		if (_proxy.splineWeights == Proxy::Weights::none) {
+			_proxy.splineWeights = Proxy::Weights::building;
+			Logger::LOG("LOG:\tBuilding spline weights, interpolation stays " + std::string(names[_proxy.interpolation]) + " until they are ready", true);
+			if (_proxy.config.splineOnGPU)
+				_proxy.tasks.push([](Proxy* _proxy)->void { buildSplineGPU(*_proxy); });
+			else {
+				//the cpu copy of the trajectory is gone after loading, read it back
+				_proxy.coords.resize(static_cast<size_t>(_proxy.ATOMCOUNT) * 3 * _proxy.TIMESTEPS);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy.c_ssbo_traj);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _proxy.coords.size() * sizeof(float), _proxy.coords.data());
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				Memory::alloc(Memory::CPU, "trajectory", _proxy.coords.size() * sizeof(float));
+				_proxy.splineThread = std::thread(&buildSplineCPU, std::ref(_proxy));
+			}
+		}
+		return;
+	}
+	_proxy.interpolation = _mode;
+	Logger::LOG("LOG:\tInterpolation: " + std::string(names[_mode]), true);
+}
+
+//hemisphere samples in tangent space, more of them close to the surface
+std::vector<Vec3> ssaoKernel(xoshiro_256& _generator, uint _size) {
+	std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+	std::vector<Vec3> kernel;
+	kernel.reserve(_size);
+	for (uint i = 0; i < _size; ++i) {
+		glm::vec3 sample(randomFloats(_generator) * 2.f - 1.f, randomFloats(_generator) * 2.f - 1.f, randomFloats(_generator));
+		sample = glm::normalize(sample);
+		sample *= randomFloats(_generator);
+		float scale = float(i) / static_cast<float>(_size);
+		scale = 0.1f - (scale * scale)*(1.0f - 0.1f);
+		sample *= scale;
+		kernel.push_back(sample);
+	}
+	return kernel;
+}
+
+//4x4 rotations of the kernel around the normal
+std::vector<Vec3> ssaoNoise(xoshiro_256& _generator) {
+	std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+	std::vector<Vec3> noise;
+	for (unsigned int i = 0; i < 16; i++)
+		noise.emplace_back(randomFloats(_generator) * 2.f - 1.f, randomFloats(_generator) * 2.f - 1.f, 0.f);
+	return noise;
+}
+
 void load(Proxy& _proxy) {
 
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
 			//COMPILE SHADERS
-			_proxy->compShader.id = "c_shader";
-#if INTERPOLATION_TYPE == 2
-			_proxy->compShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/c_shader_cub")).string());
-#elif INTERPOLATION_TYPE == 1
-			_proxy->compShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/c_shader_lin")).string());
-#else
-			_proxy->compShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/c_shader_no")).string());
-#endif
+			//the compute shaders need the boundary and weight layout, they are compiled once the memory budget is fitted
+			const Config& cfg = _proxy->config;
+			//the g-buffer layout, shared by everything that writes or reads it
+			const std::string gbuffer = std::string(cfg.compactGBuffer ? "#define COMPACT_GBUFFER\n" : "") + (cfg.atomAO ? "#define ATOM_AO\n" : "");
 			_proxy->geomShader.id = "g_shader";
-			_proxy->geomShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/g_shader")).string());
+			_proxy->geomShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + (cfg.impostors ? "shader/g_shader_impostor" : "shader/g_shader"))).string(), gbuffer);
 			_proxy->lightShader.id = "l_shader";
-#if USE_SSAO			
-			_proxy->lightShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/l_shader_ssao")).string());
-#else
-			_proxy->lightShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/l_shader")).string());
-#endif	
-#if WIDGET_SHOW
-			_proxy->widgetShader.id = "widget_shader";
-			_proxy->widgetShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/widget_shader")).string());
-#endif
-#if USE_SSAO
-			_proxy->ssaoShader.id = "ssao_shader";
-			_proxy->ssaoShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_shader")).string());
-			_proxy->ssaoBlurShader.id = "ssao_blur_shader";
-			_proxy->ssaoBlurShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_blur_shader")).string());
-#endif		
+			_proxy->lightShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + (cfg.ssao || cfg.atomAO ? "shader/l_shader_ssao" : "shader/l_shader"))).string(), gbuffer);
+			if (cfg.widget) {
+				_proxy->widgetShader.id = "widget_shader";
+				_proxy->widgetShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/widget_shader")).string());
+			}
+			if (cfg.ssao) {
+				const std::string scale = cfg.ssaoScale > 1 ? "#define SCALE " + std::to_string(cfg.ssaoScale) + "\n" : "";
+				_proxy->ssaoShader.id = "ssao_shader";
+				_proxy->ssaoShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_shader")).string(), "#define KERNEL_SIZE " + std::to_string(cfg.ssaoKernelSize) + "\n" + gbuffer + scale);
+				if (cfg.ssaoTemporal) {
+					_proxy->ssaoTemporalShader.id = "ssao_temporal_shader";
+					_proxy->ssaoTemporalShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_temporal_shader")).string(), "#define SCALE " + std::to_string(cfg.ssaoScale) + "\n");
+				}
+				if (cfg.ssaoScale > 1) {
+					_proxy->ssaoDepthShader.id = "ssao_depth_shader";
+					_proxy->ssaoDepthShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_depth_shader")).string(), scale);
+					_proxy->ssaoBilateralShader.id = "ssao_bilateral_shader";
+					_proxy->ssaoBilateralShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_bilateral_shader")).string());
+					_proxy->ssaoUpsampleShader.id = "ssao_upsample_shader";
+					_proxy->ssaoUpsampleShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_upsample_shader")).string(), scale);
+				} else {
+					_proxy->ssaoBlurShader.id = "ssao_blur_shader";
+					_proxy->ssaoBlurShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ssao_blur_shader")).string());
+				}
+			}
 		});
 	}
 
 	//PARSE FILE
 	Logger::LOG("LOG:\tLoading trajectory file:", true);
-#if USE_BINARY
-	FileParser::loadFile(_proxy.pathToFile.empty() ? 
-		std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "demo/demo_b.traj")).string() :
-		std::filesystem::absolute(std::filesystem::path(_proxy.pathToFile)).string(),
-		_proxy.coords, _proxy.ATOMCOUNT, _proxy.low, _proxy.up, _proxy.dims);
-#else
-	FileParser::loadFile(_proxy.pathToFile.empty() ?
-		std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "demo/demo_a_1000.traj")).string() :
-		std::filesystem::absolute(std::filesystem::path(_proxy.pathToFile)).string(),
-		_proxy.coords, _proxy.ATOMCOUNT, _proxy.low, _proxy.up, _proxy.dims);
-#endif
+	_proxy.loadedFile = _proxy.config.trajectory.empty() ?
+		std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + (_proxy.config.binary ? "demo/demo_b.traj" : "demo/demo_a_1000.traj"))).string() :
+		std::filesystem::absolute(std::filesystem::path(_proxy.config.trajectory)).string();
+	{
+		std::error_code ec;
+		const auto fileSize = std::filesystem::file_size(_proxy.loadedFile, ec);
+		Profiler::Scope scope("parse", ec ? 0 : static_cast<size_t>(fileSize));
+		FileParser::loadFile(_proxy.loadedFile, _proxy.config.binary, _proxy.coords, _proxy.ATOMCOUNT, _proxy.low, _proxy.up, _proxy.dims);
+	}
 
 	_proxy.TIMESTEPS = static_cast<uint>(_proxy.coords.size() / 3) / _proxy.ATOMCOUNT;
 
-	Logger::LOG("\t -> Atoms: " + std::to_string(_proxy.ATOMCOUNT) + " Steps: " + std::to_string(_proxy.TIMESTEPS) + "", false);
-	Logger::LOG("\t -> Points: " + std::to_string(_proxy.coords.size()/3), false);
-	Logger::LOG("\t -> Bounds: [" + std::to_string(_proxy.up.x) + ", " + std::to_string(_proxy.up.y) + ", " + std::to_string(_proxy.up.z) + "]\n", false);
+	//MEMORY BUDGET
+	//fitted on a copy, the render thread reads the config while it compiles the shaders. The fallbacks are published with a task
+	Config fitted = _proxy.config;
+	const uint stride = Memory::fit(fitted, _proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.wWidth, _proxy.wHeight);
+	if (fitted.interpolation != _proxy.config.interpolation)
+		_proxy.tasks.push([interpolation = fitted.interpolation](Proxy* _proxy)->void { _proxy->config.interpolation = interpolation; });
+	if (stride > 1)
+		_proxy.TIMESTEPS = FileParser::stride(_proxy.coords, _proxy.ATOMCOUNT, stride);
+	Memory::alloc(Memory::CPU, "trajectory", _proxy.coords.size() * sizeof(float));
+
+	//PBC UNWRAP
+	//once for every interpolation, before the upload. The compute shaders wrap the positions back into the box
+	if (_proxy.config.cyclicBoundaries && _proxy.TIMESTEPS > 1) {
+		Profiler::Scope scope("unwrap", _proxy.coords.size() * sizeof(float));
+		Periodic::unwrap(_proxy.coords, _proxy.ATOMCOUNT, _proxy.dims);
+	}
+	_proxy.interpolation = _proxy.requestedInterpolation = fitted.interpolation;
+	//with culling every sphere level up to the configured one is kept, one LOD each. Impostors need none
+	_proxy.LODS = _proxy.config.culling && !_proxy.config.impostors ? _proxy.config.sphereSubdivisions + 1 : 1;
+	//cells at least one shell wide so the 27 around an atom hold all its neighbours, at most 2 per atom
+	if (_proxy.config.atomAO) {
+		const Vec3 d = _proxy.dims;
+		const float maxCells = static_cast<float>(std::min<size_t>(2 * static_cast<size_t>(_proxy.ATOMCOUNT), size_t(1) << 21));
+		const float cell = std::max(_proxy.config.atomAORadius, std::cbrt(d.x * d.y * d.z / maxCells));
+		const float extent[3] = { d.x, d.y, d.z };
+		for (int k = 0; k < 3; ++k) {
+			_proxy.aoCells[k] = std::max(1, static_cast<int>(extent[k] / cell));
+			_proxy.aoInvCell[k] = extent[k] > 0.f ? _proxy.aoCells[k] / extent[k] : 0.f;
+		}
+	}
 
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
-			glGenBuffers(1, &_proxy->c_ssbo_traj);
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_traj);
-			glBufferData(GL_SHADER_STORAGE_BUFFER, _proxy->coords.size() * sizeof(float), _proxy->coords.data(), GL_STATIC_DRAW);
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-			glGenBuffers(1, &_proxy->cg_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, _proxy->cg_vbo);
-			glBufferData(GL_ARRAY_BUFFER, _proxy->ATOMCOUNT * _proxy->VERTEXSIZE * _proxy->SPHEREVERTICES * sizeof(float), nullptr, GL_STATIC_DRAW);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glMemoryBarrier(GL_ALL_BARRIER_BITS);
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			const Config& cfg = _proxy->config;
+			//the motion buffer and storeMotion are shared by all four, injected with the defines
+			std::string motion;
+			if (cfg.motion) {
+				std::ifstream file(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/motion.glsl")));
+				motion = "#define MOTION\n" + std::string{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() } + "\n";
+			}
+			const std::string cbc = "#define CBC " + std::to_string(cfg.cyclicBoundaries ? 1 : 0) + "\n" + (cfg.compactSpline ? "#define COMPACT\n" : "") + motion;
+			const char* interpolation[] = { "c_shader_no", "c_shader_lin", "c_shader_cub", "c_shader_cr" };
+			for (uint i = 0; i < 4; ++i) {
+				_proxy->compShaders[i].id = interpolation[i];
+				_proxy->compShaders[i].compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/" + interpolation[i])).string(), cbc);
+			}
+			if (cfg.culling) {
+				_proxy->cullShader.id = "cull_shader";
+				_proxy->cullShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/cull_shader")).string(),
+					"#define LODS " + std::to_string(_proxy->LODS) + "\n#define STRIDE " + std::to_string(cfg.impostors ? 4 : 5) + "\n" + (cfg.occlusion ? "#define OCCLUSION\n" : "") + (cfg.atomAO ? "#define ATOM_AO\n" : ""));
+			}
+			if (cfg.atomAO) {
+				const char* passes[] = { "ao_count", "ao_scan", "ao_scatter", "ao_occlusion" };
+				for (uint i = 0; i < 4; ++i) {
+					_proxy->aoShaders[i].id = passes[i];
+					_proxy->aoShaders[i].compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/ao_shader")).string(),
+						"#define PASS " + std::to_string(i) + "\n#define CBC " + std::to_string(cfg.cyclicBoundaries ? 1 : 0) + "\n");
+				}
+			}
+			if (cfg.occlusion) {
+				_proxy->hizShader.id = "hiz_shader";
+				_proxy->hizShader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/hiz_shader")).string());
+			}
 		});
 	}
 
+	Logger::LOG("\t -> Atoms: " + std::to_string(_proxy.ATOMCOUNT) + " Steps: " + std::to_string(_proxy.TIMESTEPS) + "", false);
+	Logger::LOG("\t -> Points: " + std::to_string(_proxy.coords.size()/3), false);
+	Logger::LOG("\t -> Bounds: [" + std::to_string(_proxy.up.x) + ", " + std::to_string(_proxy.up.y) + ", " + std::to_string(_proxy.up.z) + "]\n", false);
+
+	uploadSliced(_proxy, &_proxy.c_ssbo_traj, GL_SHADER_STORAGE_BUFFER, _proxy.coords.data(), _proxy.coords.size() * sizeof(float), "trajectory");
+
 	{
 		Vec3 cntr;
 		for (uint i = 0; i < 3; ++i)
@@ -169,159 +460,168 @@ void load(Proxy& _proxy) {
 
 		_proxy.controller = CameraController(&_proxy.cam);
 
-#if WIDGET_SHOW
-		_proxy.widgetWidth = WIDGET_WIDTH;
-		_proxy.widgetHeight = WIDGET_HEIGHT;
-		_proxy.widgetCam = Camera(false, _proxy.widgetWidth, _proxy.widgetHeight);
-		_proxy.widgetCam.nearPlane = 1.f;
-		_proxy.widgetCam.farPlane = 50;
-		_proxy.widgetCam.position = Vec3(-50.f, 0.f, 0.f);
-		_proxy.widgetCam.direction = Vec3(1.f, 0.f, 0.f);
-		_proxy.widgetCam.up = Vec3(0.f, 1.f, 0.f);
-		_proxy.widgetCam.update();
-		Logger::LOG("LOG:\tCamera: fov: " + std::to_string(_proxy.widgetCam.fieldOfView) + " near: " + std::to_string(_proxy.widgetCam.nearPlane) + " far: " + std::to_string(_proxy.widgetCam.farPlane) + "\n", true);
-#else
-		Logger::LOG("", false);
-#endif
+		if (_proxy.config.widget) {
+			_proxy.widgetWidth = _proxy.config.widgetWidth;
+			_proxy.widgetHeight = _proxy.config.widgetHeight;
+			_proxy.widgetCam = Camera(false, _proxy.widgetWidth, _proxy.widgetHeight);
+			_proxy.widgetCam.nearPlane = 1.f;
+			_proxy.widgetCam.farPlane = 50;
+			_proxy.widgetCam.position = Vec3(-50.f, 0.f, 0.f);
+			_proxy.widgetCam.direction = Vec3(1.f, 0.f, 0.f);
+			_proxy.widgetCam.up = Vec3(0.f, 1.f, 0.f);
+			_proxy.widgetCam.update();
+			Logger::LOG("LOG:\tCamera: fov: " + std::to_string(_proxy.widgetCam.fieldOfView) + " near: " + std::to_string(_proxy.widgetCam.nearPlane) + " far: " + std::to_string(_proxy.widgetCam.farPlane) + "\n", true);
+		} else
+			Logger::LOG("", false);
 		
 	}
 	
 	//CREATE SPHERE
-	assert(SPHERE_SUBDIVISIONS >= 0);
-	auto sphere = Icosahedron::create(SPHERE_SUBDIVISIONS);
-	_proxy.sphere_vertices = std::get<0>(sphere);
-	auto& sphere_indices = std::get<1>(sphere);
-
-	Logger::LOG("LOG:\tIcosahedron created subdivisions: " + std::to_string(SPHERE_SUBDIVISIONS) + ", indices: " + std::to_string(sphere_indices.size()) + ", vertices: " + std::to_string(_proxy.sphere_vertices.size()) + "\n", true);
+	const auto sphereStart = std::chrono::high_resolution_clock::now();
+	_proxy.sphere = Icosahedron::get(_proxy.config.sphereSubdivisions);
 
-	//MERGE INDICES OF SPHERES
-	size_t indexSize = sphere_indices.size();
-	uint maxIndex = *std::max_element(sphere_indices.begin(), sphere_indices.end()) + 1;
-	_proxy.sphere_indices.resize(indexSize * _proxy.ATOMCOUNT);
-
-	for (size_t s = 0; s < _proxy.ATOMCOUNT; ++s)
-		for (size_t i = 0; i < indexSize; ++i)
-			_proxy.sphere_indices[s * indexSize + i] = sphere_indices[i] + s * maxIndex;
+	Logger::LOG("LOG:\tIcosahedron loaded subdivisions: " + std::to_string(_proxy.config.sphereSubdivisions) + ", indices: " + std::to_string(_proxy.sphere.indexCount) + ", vertices: " + std::to_string(_proxy.sphere.vertexCount) + "\n", true);
 
 	//GL CONSTANTS
-	_proxy.SPHEREVERTICES = _proxy.sphere_vertices.size() / _proxy.SPHEREVERTEXSIZE;
-	_proxy.INDEXCOUNT = _proxy.sphere_indices.size();
-
-	Logger::LOG("LOG:\tIndices merged for " + std::to_string(_proxy.ATOMCOUNT) + " atoms: " + std::to_string(_proxy.INDEXCOUNT) + "\n", true);
-
-	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
-			glGenBuffers(1, &_proxy->c_ssbo_sphere);
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_sphere);
-			glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<uint>(_proxy->sphere_vertices.size()) * sizeof(float), _proxy->sphere_vertices.data(), GL_STATIC_DRAW);
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-			glGenBuffers(1, &_proxy->g_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _proxy->g_ebo);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, _proxy->INDEXCOUNT * sizeof(uint), _proxy->sphere_indices.data(), GL_STATIC_DRAW);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-			glMemoryBarrier(GL_ALL_BARRIER_BITS);
-		});
+	const Config& cfg = _proxy.config;
+	_proxy.SPHEREVERTICES = _proxy.INDEXCOUNT = 0;
+	_proxy.drawCommands.clear();
+	for (uint l = cfg.sphereSubdivisions + 1 - _proxy.LODS; l <= cfg.sphereSubdivisions; ++l) {
+		const Icosphere::Mesh mesh = Icosahedron::get(l);
+		//DrawElementsIndirectCommand: count, instanceCount, firstIndex, baseVertex, baseInstance. The cull pass fills in instanceCount
+		//DrawArraysIndirectCommand for the impostor quad: count, instanceCount, first, baseInstance
+		const uint lod = static_cast<uint>(_proxy.drawCommands.size()) / (cfg.impostors ? 4 : 5);
+		if (cfg.impostors)
+			_proxy.drawCommands.insert(_proxy.drawCommands.end(), { 4u, 0u, 0u, 0u });
+		else
+			_proxy.drawCommands.insert(_proxy.drawCommands.end(), { mesh.indexCount, 0u, _proxy.INDEXCOUNT, _proxy.SPHEREVERTICES, lod * _proxy.ATOMCOUNT });
+		_proxy.SPHEREVERTICES += mesh.vertexCount;
+		_proxy.INDEXCOUNT += mesh.indexCount;
 	}
-
-	//CREATE AUX BUFFER
-	_proxy.auxBuffer.resize(_proxy.ATOMCOUNT * _proxy.SPHEREVERTICES * _proxy.AUXVERTEXSIZE);
-	for (uint i = 0; i < _proxy.SPHEREVERTICES; ++i) {
-		//nrm 
-		Vec3 v = glm::normalize(Vec3(_proxy.sphere_vertices[3 * i], _proxy.sphere_vertices[3 * i + 1], _proxy.sphere_vertices[3 * i + 2]));
-		std::memcpy(_proxy.auxBuffer.data() + i * _proxy.AUXVERTEXSIZE, glm::value_ptr(v), 3 * sizeof(float));
-		//t
-		Vec3 t = glm::normalize(glm::cross(v, Vec3(0.f, 1.f, 0.f)));
-		if (std::isnan(t[0]) || std::isnan(t[1]) || std::isnan(t[2]))
-			t = glm::normalize(glm::cross(v, Vec3(1.f, 0.f, 0.f)));
-		std::memcpy(_proxy.auxBuffer.data() + i * _proxy.AUXVERTEXSIZE + 3, glm::value_ptr(t), 3 * sizeof(float));
-		//bt
-		Vec3 bt = glm::normalize(glm::cross(v, t));
-		std::memcpy(_proxy.auxBuffer.data() + i * _proxy.AUXVERTEXSIZE + 6, glm::value_ptr(bt), 3 * sizeof(float));
+	//occlusion culling draws twice, the second set of commands starts at the second set of lists
+	if (cfg.occlusion) {
+		const size_t stride = cfg.impostors ? 4 : 5;
+		const size_t count = _proxy.drawCommands.size();
+		for (size_t i = 0; i < count; ++i)
+			_proxy.drawCommands.push_back(_proxy.drawCommands[i] + (i % stride == stride - 1 ? _proxy.LODS * _proxy.ATOMCOUNT : 0));
 	}
 
-	for (uint i = 1; i < _proxy.ATOMCOUNT; ++i) {
-		std::memcpy(_proxy.auxBuffer.data() + i * (_proxy.SPHEREVERTICES * _proxy.AUXVERTEXSIZE), _proxy.auxBuffer.data(), _proxy.SPHEREVERTICES * _proxy.AUXVERTEXSIZE * sizeof(float));
-	}
-
-	Logger::LOG("LOG:\tAux buffer created: Normals, Tangents and Bitangents\n", true);
-
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			//one icosphere per LOD for all atoms: positions, normals + tangents + bitangents and indices, the geometry pass instances it
+			const size_t vertexBytes = _proxy->SPHEREVERTICES * _proxy->SPHEREVERTEXSIZE * sizeof(float);
+			const size_t auxBytes = _proxy->SPHEREVERTICES * _proxy->AUXVERTEXSIZE * sizeof(float);
+			const size_t indexBytes = _proxy->INDEXCOUNT * sizeof(uint);
+			Profiler::Scope scope("upload", vertexBytes + auxBytes + indexBytes);
+
+			glGenBuffers(1, &_proxy->g_vbo_sphere);
+			glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_sphere);
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+			Memory::alloc(Memory::GPU, "sphere", vertexBytes);
+
 			glGenBuffers(1, &_proxy->g_vbo_aux);
 			glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_aux);
-			glBufferData(GL_ARRAY_BUFFER, _proxy->auxBuffer.size() * sizeof(float), _proxy->auxBuffer.data(), GL_STATIC_DRAW);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glMemoryBarrier(GL_ALL_BARRIER_BITS);
-		});
-	}
+			glBufferData(GL_ARRAY_BUFFER, auxBytes, nullptr, GL_STATIC_DRAW);
+			Memory::alloc(Memory::GPU, "aux", auxBytes);
 
-	if (_proxy.TIMESTEPS > 1) {
+			glGenBuffers(1, &_proxy->g_ebo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _proxy->g_ebo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+			Memory::alloc(Memory::GPU, "indices", indexBytes);
+
+			//indices stay relative to their level, baseVertex offsets them
+			const uint finest = _proxy->config.sphereSubdivisions;
+			size_t vertex = 0, index = 0;
+			for (uint l = finest + 1 - _proxy->LODS; l <= finest; ++l) {
+				const Icosphere::Mesh mesh = Icosahedron::get(l);
+				glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_sphere);
+				glBufferSubData(GL_ARRAY_BUFFER, vertex * _proxy->SPHEREVERTEXSIZE * sizeof(float), mesh.vertexCount * _proxy->SPHEREVERTEXSIZE * sizeof(float), mesh.vertices);
+				glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_aux);
+				glBufferSubData(GL_ARRAY_BUFFER, vertex * _proxy->AUXVERTEXSIZE * sizeof(float), mesh.vertexCount * _proxy->AUXVERTEXSIZE * sizeof(float), mesh.aux);
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index * sizeof(uint), mesh.indexCount * sizeof(uint), mesh.indices);
+				vertex += mesh.vertexCount;
+				index += mesh.indexCount;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-#if COMPUTE_SPLINE_ON_GPU && INTERPOLATION_TYPE == 2
-		{
-			std::lock_guard<std::mutex> lock(_proxy.mutex);
-			_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+			//per LOD lists of the visible centres and the indirect draws over them, both written by the cull pass
+			if (_proxy->config.culling) {
+				const size_t sets = _proxy->config.occlusion ? 2 : 1;
+				const size_t visibleBytes = sets * _proxy->LODS * _proxy->ATOMCOUNT * _proxy->VERTEXSIZE * sizeof(float);
+				glGenBuffers(1, &_proxy->c_ssbo_visible);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_visible);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, visibleBytes, nullptr, GL_DYNAMIC_COPY);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				Memory::alloc(Memory::GPU, "visible", visibleBytes);
 
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
+				glGenBuffers(1, &_proxy->g_indirect);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _proxy->g_indirect);
+				glBufferData(GL_DRAW_INDIRECT_BUFFER, _proxy->drawCommands.size() * sizeof(uint), _proxy->drawCommands.data(), GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			}
 
-				glGenBuffers(1, &_proxy->c_ssbo_weights);
-				glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_weights);
-				glBufferData(GL_SHADER_STORAGE_BUFFER, _proxy->ATOMCOUNT * 12 * sizeof(float) * _proxy->TIMESTEPS, nullptr, GL_STATIC_DRAW);
+			//nothing was visible before the first frame, it draws everything in the second phase
+			if (_proxy->config.occlusion) {
+				glGenBuffers(1, &_proxy->c_ssbo_visibility);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_visibility);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<size_t>(_proxy->ATOMCOUNT) * sizeof(uint), nullptr, GL_DYNAMIC_COPY);
+				glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				Memory::alloc(Memory::GPU, "visibility", static_cast<size_t>(_proxy->ATOMCOUNT) * sizeof(uint));
+			}
 
-				GLuint tmp;
-				glGenBuffers(1, &tmp);
-				glBindBuffer(GL_SHADER_STORAGE_BUFFER, tmp);
-				glBufferData(GL_SHADER_STORAGE_BUFFER, _proxy->ATOMCOUNT * _proxy->TIMESTEPS * 2 * sizeof(float), nullptr, GL_STATIC_DRAW);
+			//grid, per atom cell and slot, atoms in cell order and their occlusion. Culled, one occlusion per visible centre as well
+			if (_proxy->config.atomAO) {
+				const size_t atoms = _proxy->ATOMCOUNT;
+				const size_t cells = static_cast<size_t>(_proxy->aoCells[0]) * _proxy->aoCells[1] * _proxy->aoCells[2];
+				const size_t sizes[5] = { cells, cells, 2 * atoms, atoms, atoms };
+				GLuint* buffers[5] = { &_proxy->a_ssbo_count, &_proxy->a_ssbo_start, &_proxy->a_ssbo_cell, &_proxy->a_ssbo_sorted, &_proxy->a_ssbo_ao };
+				size_t aoBytes = 0;
+				for (int i = 0; i < 5; ++i) {
+					glGenBuffers(1, buffers[i]);
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, *buffers[i]);
+					glBufferData(GL_SHADER_STORAGE_BUFFER, sizes[i] * sizeof(uint), nullptr, GL_DYNAMIC_COPY);
+					aoBytes += sizes[i] * sizeof(uint);
+				}
+				if (_proxy->config.culling) {
+					const size_t visibleBytes = (_proxy->config.occlusion ? 2 : 1) * _proxy->LODS * atoms * sizeof(float);
+					glGenBuffers(1, &_proxy->c_ssbo_visible_ao);
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_visible_ao);
+					glBufferData(GL_SHADER_STORAGE_BUFFER, visibleBytes, nullptr, GL_DYNAMIC_COPY);
+					aoBytes += visibleBytes;
+				}
 				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				Memory::alloc(Memory::GPU, "atom_ao", aoBytes);
+			}
 
-				ShaderProgram shader;
-				shader.id = "t_shader";
-				shader.compileFromFile(std::filesystem::absolute(std::filesystem::path(VSC_WORKDIR_OFFSET + "shader/t_shader")).string());
-				shader.bind();
-
-				//buffers
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _proxy->c_ssbo_traj);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _proxy->c_ssbo_weights);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tmp);
-
-				//uniforms
-				glUniform1i(1, _proxy->ATOMCOUNT);
-				glUniform1i(2, _proxy->TIMESTEPS);
-				glUniform3fv(3, 1, glm::value_ptr(_proxy->dims));
-
-				glDispatchCompute(_proxy->ATOMCOUNT, 1, 1);
-
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
-				shader.unbind();
-
-				glDeleteBuffers(1, &tmp);
-
-				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-				Logger::LOG("LOG:\tSpline interpolated.\n", true);
+			//atom centres, written by the compute pass every frame
+			glGenBuffers(1, &_proxy->cg_vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, _proxy->cg_vbo);
+			glBufferData(GL_ARRAY_BUFFER, static_cast<size_t>(_proxy->ATOMCOUNT) * _proxy->VERTEXSIZE * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			Memory::alloc(Memory::GPU, "centres", static_cast<size_t>(_proxy->ATOMCOUNT) * _proxy->VERTEXSIZE * sizeof(float));
 
-			});
-		}
-#elif INTERPOLATION_TYPE == 2
-		{
-			SplineBuilder::build(_proxy.ATOMCOUNT, _proxy.TIMESTEPS, _proxy.dims, _proxy.coords, _proxy.weights);
-			{
-				std::lock_guard<std::mutex> lock(_proxy.mutex);
-				_proxy.asyncQueue.push([](Proxy* _proxy)->void {
-					glGenBuffers(1, &_proxy->c_ssbo_weights);
-					glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_weights);
-					glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<uint>(_proxy->weights.size()) * sizeof(float), _proxy->weights.data(), GL_STATIC_DRAW);
-					glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-					Logger::LOG("LOG:\tSpline interpolated.\n", true);
-				});
+			//velocity and acceleration, written by the compute pass next to the centres
+			if (_proxy->config.motion) {
+				glGenBuffers(1, &_proxy->c_ssbo_motion);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->c_ssbo_motion);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<size_t>(_proxy->ATOMCOUNT) * 3 * sizeof(uint), nullptr, GL_DYNAMIC_COPY);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+				Memory::alloc(Memory::GPU, "motion", static_cast<size_t>(_proxy->ATOMCOUNT) * 3 * sizeof(uint));
 			}
-
-		}
-#endif // COMPUTE_SPLINE_ON_GPU
+			glMemoryBarrier(GL_ALL_BARRIER_BITS);
+		});
+	}
+	Profiler::record("sphere_setup", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sphereStart).count(),
+		_proxy.SPHEREVERTICES * (_proxy.SPHEREVERTEXSIZE + _proxy.AUXVERTEXSIZE) * sizeof(float) + _proxy.INDEXCOUNT * sizeof(uint));
+
+	if (_proxy.TIMESTEPS > 1 && fitted.interpolation == 2) {
+		_proxy.splineWeights = Proxy::Weights::building;
+		if (_proxy.config.splineOnGPU)
+			_proxy.tasks.push([](Proxy* _proxy)->void { buildSplineGPU(*_proxy); });
+		else
+			buildSplineCPU(_proxy);
 	}
 
 	//Lights
@@ -359,18 +659,34 @@ void load(Proxy& _proxy) {
 	_proxy.lights.emplace_back(1.f);
 
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
 			//CREATE VAO FOR DRAWING
+			Profiler::Scope scope("vao_setup");
 			glGenVertexArrays(1, &_proxy->g_vao);
 			glBindVertexArray(_proxy->g_vao);
 
-			glBindBuffer(GL_ARRAY_BUFFER, _proxy->cg_vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_sphere);
 
-			//pos
+			//sphere vertex
+			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, _proxy->SPHEREVERTEXSIZE * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(4);
+
+			//culled: the visible lists, the draw commands start each LOD at its list with baseInstance
+			glBindBuffer(GL_ARRAY_BUFFER, _proxy->config.culling ? _proxy->c_ssbo_visible : _proxy->cg_vbo);
+
+			//centre, one per instance
 			glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, _proxy->VERTEXSIZE * sizeof(float), (void*)0);
+			glVertexAttribDivisor(5, 1);
 			glEnableVertexAttribArray(5);
 
+			//occlusion, one per instance next to the centre
+			if (_proxy->config.atomAO) {
+				glBindBuffer(GL_ARRAY_BUFFER, _proxy->config.culling ? _proxy->c_ssbo_visible_ao : _proxy->a_ssbo_ao);
+				glVertexAttribPointer(10, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+				glVertexAttribDivisor(10, 1);
+				glEnableVertexAttribArray(10);
+			}
+
 			glBindBuffer(GL_ARRAY_BUFFER, _proxy->g_vbo_aux);
 
 			//nrm
@@ -392,70 +708,105 @@ void load(Proxy& _proxy) {
 	}
 
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			//5 RGB16F targets + depth stencil, or RG16 normal + RGBA8 albedo + depth stencil
+			const bool compact = _proxy->config.compactGBuffer;
+			const size_t bytes = static_cast<size_t>(_proxy->wWidth) * _proxy->wHeight * (compact ? 4 + 4 + 4 : 5 * 6 + 4 + (_proxy->config.atomAO ? 2 : 0));
+			Profiler::Scope scope("framebuffer_setup", bytes);
+			Memory::alloc(Memory::GPU, "gbuffer", bytes);
 			glGenFramebuffers(1, &_proxy->g_fb);
 			glBindFramebuffer(GL_FRAMEBUFFER, _proxy->g_fb);
 
-			//pos
-			glGenTextures(1, &_proxy->g_pos);
-			glBindTexture(GL_TEXTURE_2D, _proxy->g_pos);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->g_pos, 0);
+			if (compact) {
+				//nrm, octahedral
+				glGenTextures(1, &_proxy->g_nrm);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_nrm);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16_SNORM, _proxy->wWidth, _proxy->wHeight, 0, GL_RG, GL_SHORT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->g_nrm, 0);
 
-			//nrm
-			glGenTextures(1, &_proxy->g_nrm);
-			glBindTexture(GL_TEXTURE_2D, _proxy->g_nrm);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, _proxy->g_nrm, 0);
-
-			//t
-			glGenTextures(1, &_proxy->g_t);
-			glBindTexture(GL_TEXTURE_2D, _proxy->g_t);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, _proxy->g_t, 0);
-
-			//bt
-			glGenTextures(1, &_proxy->g_bt);
-			glBindTexture(GL_TEXTURE_2D, _proxy->g_bt);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, _proxy->g_bt, 0);
+				//col
+				glGenTextures(1, &_proxy->g_col);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_col);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _proxy->wWidth, _proxy->wHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, _proxy->g_col, 0);
+
+				uint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+				glDrawBuffers(2, attachments);
+			} else {
+				//pos
+				glGenTextures(1, &_proxy->g_pos);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_pos);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->g_pos, 0);
 
-			//col
-			glGenTextures(1, &_proxy->g_col);
-			glBindTexture(GL_TEXTURE_2D, _proxy->g_col);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+				//nrm
+				glGenTextures(1, &_proxy->g_nrm);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_nrm);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, _proxy->g_nrm, 0);
+
+				//t
+				glGenTextures(1, &_proxy->g_t);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_t);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, _proxy->g_t, 0);
+
+				//bt
+				glGenTextures(1, &_proxy->g_bt);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_bt);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, _proxy->g_bt, 0);
+
+				//col, the atom occlusion in alpha
+				glGenTextures(1, &_proxy->g_col);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_col);
+				if (_proxy->config.atomAO)
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+				else
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, _proxy->g_col, 0);
+
+				uint attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+				glDrawBuffers(5, attachments);
+			}
+			
+			//depth, a texture so the passes after the geometry can read it
+			glGenTextures(1, &_proxy->g_depth);
+			glBindTexture(GL_TEXTURE_2D, _proxy->g_depth);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, _proxy->wWidth, _proxy->wHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, _proxy->g_col, 0);
-
-			uint attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
-			glDrawBuffers(5, attachments);
-			
-			//depth
-			glGenRenderbuffers(1, &_proxy->g_depth);
-			glBindRenderbuffer(GL_RENDERBUFFER, _proxy->g_depth);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _proxy->wWidth, _proxy->wHeight);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _proxy->g_depth);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _proxy->g_depth);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, _proxy->g_depth, 0);
 	
 			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 				Logger::LOG("ERROR:\tAuxiliary Framebuffer not complete! Shutting down...", true);
@@ -464,14 +815,29 @@ void load(Proxy& _proxy) {
 
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+			//farthest depth pyramid for the occlusion culling, level sizes rounded down
+			if (_proxy->config.occlusion) {
+				_proxy->hizLevels = 1;
+				while ((std::max(_proxy->wWidth, _proxy->wHeight) >> _proxy->hizLevels) > 0)
+					++_proxy->hizLevels;
+				glGenTextures(1, &_proxy->g_hiz);
+				glBindTexture(GL_TEXTURE_2D, _proxy->g_hiz);
+				glTexStorage2D(GL_TEXTURE_2D, _proxy->hizLevels, GL_R32F, _proxy->wWidth, _proxy->wHeight);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				Memory::alloc(Memory::GPU, "depth pyramid", static_cast<size_t>(_proxy->wWidth) * _proxy->wHeight * sizeof(float) * 4 / 3);
+			}
+
 			glMemoryBarrier(GL_ALL_BARRIER_BITS);
 		});
 	}
 
-#if WIDGET_SHOW
-	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+	if (_proxy.config.widget) {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			Profiler::Scope scope("widget_setup");
 
 			objl::Loader Loader;
 			if (!Loader.LoadFile(VSC_WORKDIR_OFFSET + "axis.obj"))
@@ -506,6 +872,7 @@ void load(Proxy& _proxy) {
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_widget);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, curMesh.Indices.size() * sizeof(uint), curMesh.Indices.data(), GL_STATIC_DRAW);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			Memory::alloc(Memory::GPU, "widget", vertices.size() * sizeof(float) + curMesh.Indices.size() * sizeof(uint));
 
 			glGenVertexArrays(1, &_proxy->widget_vao);
 			glBindVertexArray(_proxy->widget_vao);
@@ -524,10 +891,9 @@ void load(Proxy& _proxy) {
 
 		});
 	}
-#endif
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			Profiler::Scope scope("vao_setup");
 			const float vert[] = {
 				-1.f, -1.f, 0.f, 0.f,
 				1.f, -1.f, 1.f, 0.f,
@@ -566,40 +932,36 @@ void load(Proxy& _proxy) {
 		});
 	}
 	// -------------------- SSAO --------------------
-#if USE_SSAO
-	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
-			//kernel
-			std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
-			xoshiro_256 generator;
-			std::vector<Vec3> ssaoKernel;
-			const uint kernelSize = SSAO_KERNEL_SIZE;
-			for (unsigned int i = 0; i < kernelSize; ++i) {
-				glm::vec3 sample(randomFloats(generator) * 2.f - 1.f, randomFloats(generator) * 2.f - 1.f, randomFloats(generator));
-				sample = glm::normalize(sample);
-				sample *= randomFloats(generator);
-				float scale = float(i) / static_cast<float>(kernelSize);
-				scale = 0.1f - (scale * scale)*(1.0f - 0.1f);
-				sample *= scale;
-				ssaoKernel.push_back(sample);
-			}
+	if (_proxy.config.ssao) {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
+			//kernel, noise, ssao + blur target. At a lower scale: view z, ssao and blur there, the upsampled ssao
+			const uint scale = _proxy->config.ssaoScale;
+			const int sWidth = std::max(_proxy->wWidth / static_cast<int>(scale), 1);
+			const int sHeight = std::max(_proxy->wHeight / static_cast<int>(scale), 1);
+			const size_t pixels = static_cast<size_t>(_proxy->wWidth) * _proxy->wHeight;
+			const size_t ssaoBytes = _proxy->config.ssaoKernelSize * sizeof(Vec3) + 16 * sizeof(Vec3) + (scale > 1 ? static_cast<size_t>(sWidth) * sHeight * (4 + 2 + 2) + pixels : pixels * (2 + 1))
+				+ (_proxy->config.ssaoTemporal ? static_cast<size_t>(sWidth) * sHeight * 2 * 6 : 0);
+			Profiler::Scope scope("ssao_setup", ssaoBytes);
+			Memory::alloc(Memory::GPU, "ssao", ssaoBytes);
+			//kernel, the temporal mode draws a new one every frame
+			const bool temporal = _proxy->config.ssaoTemporal;
+			_proxy->s_noiseStream = _proxy->s_kernelStream;
+			_proxy->s_noiseStream.jump();
+			const std::vector<Vec3> kernel = ssaoKernel(_proxy->s_kernelStream, _proxy->config.ssaoKernelSize);
 
 			glGenBuffers(1, &_proxy->s_samples);
 			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _proxy->s_samples);
-			glBufferData(GL_SHADER_STORAGE_BUFFER, ssaoKernel.size() * sizeof(Vec3), ssaoKernel.data(), GL_STATIC_DRAW);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, kernel.size() * sizeof(Vec3), kernel.data(), temporal ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
 			//noise
-			_proxy->s_bounds = Vec2(_proxy->wWidth, _proxy->wHeight);
-			std::vector<Vec3> ssaoNoise;
-			for (unsigned int i = 0; i < 16; i++)
-				ssaoNoise.emplace_back(randomFloats(generator) * 2.f - 1.f, randomFloats(generator) * 2.f - 1.f, 0.f);
+			_proxy->s_bounds = Vec2(sWidth, sHeight);
+			const std::vector<Vec3> noise = ssaoNoise(_proxy->s_noiseStream);
 			
 			//noise tex
 			glGenTextures(1, &_proxy->s_rand);
 			glBindTexture(GL_TEXTURE_2D, _proxy->s_rand);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, ssaoNoise.data());
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, noise.data());
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -612,7 +974,7 @@ void load(Proxy& _proxy) {
 
 			glGenTextures(1, &_proxy->s_ssao);
 			glBindTexture(GL_TEXTURE_2D, _proxy->s_ssao);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, _proxy->wWidth, _proxy->wHeight, 0, GL_RED, GL_FLOAT, NULL);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, sWidth, sHeight, 0, GL_RED, GL_FLOAT, NULL);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -622,11 +984,10 @@ void load(Proxy& _proxy) {
 			GLuint attachments[1] = { GL_COLOR_ATTACHMENT0 };
 			glDrawBuffers(1, attachments);
 
-			//depth
-			glBindRenderbuffer(GL_RENDERBUFFER, _proxy->g_depth);
-			//glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _proxy->wWidth, _proxy->wHeight);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _proxy->g_depth);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _proxy->g_depth);
+			//depth, for the stencil. The compact g-buffer samples the depth in this pass, attached it would be a feedback loop.
+			//A reduced target cannot share it, the shaders skip the background instead
+			if (!_proxy->config.compactGBuffer && scale == 1)
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, _proxy->g_depth, 0);
 
 			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 				Logger::LOG("ERROR:\tSSAO Framebuffer not complete! Shutting down...", true);
@@ -645,50 +1006,639 @@ void load(Proxy& _proxy) {
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->ss_b_tex, 0);
 
+			if (scale > 1) {
+				//view z at the ssao resolution
+				glGenFramebuffers(1, &_proxy->s_depth_fb);
+				glBindFramebuffer(GL_FRAMEBUFFER, _proxy->s_depth_fb);
+				glGenTextures(1, &_proxy->s_depth);
+				glBindTexture(GL_TEXTURE_2D, _proxy->s_depth);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, sWidth, sHeight, 0, GL_RED, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->s_depth, 0);
+
+				//first blur direction
+				glGenFramebuffers(1, &_proxy->s_blur_fb);
+				glBindFramebuffer(GL_FRAMEBUFFER, _proxy->s_blur_fb);
+				glGenTextures(1, &_proxy->s_blur);
+				glBindTexture(GL_TEXTURE_2D, _proxy->s_blur);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, sWidth, sHeight, 0, GL_RED, GL_FLOAT, NULL);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->s_blur, 0);
+
+				if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+					Logger::LOG("ERROR:\tSSAO blur Framebuffer not complete! Shutting down...", true);
+					_proxy->shouldTerminate = true;
+				}
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+
+			if (temporal) {
+				//ao, distance, frames. Cleared to distance 0, which no pixel matches, so the first frame starts over
+				glGenFramebuffers(2, _proxy->s_history_fb);
+				glGenTextures(2, _proxy->s_history);
+				for (int i = 0; i < 2; ++i) {
+					glBindFramebuffer(GL_FRAMEBUFFER, _proxy->s_history_fb[i]);
+					glBindTexture(GL_TEXTURE_2D, _proxy->s_history[i]);
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, sWidth, sHeight, 0, GL_RGB, GL_FLOAT, NULL);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _proxy->s_history[i], 0);
+					glClearColor(0.f, 0.f, 0.f, 0.f);
+					glClear(GL_COLOR_BUFFER_BIT);
+				}
+				if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+					Logger::LOG("ERROR:\tSSAO history Framebuffer not complete! Shutting down...", true);
+					_proxy->shouldTerminate = true;
+				}
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+
 			glMemoryBarrier(GL_ALL_BARRIER_BITS);
 		});
 	}
-#endif
 	// -------------------- Finalizing --------------------
 	{
-		std::lock_guard<std::mutex> lock(_proxy.mutex);
-		_proxy.asyncQueue.push([](Proxy* _proxy)->void {
+		_proxy.tasks.push([](Proxy* _proxy)->void {
 		
 
 			_proxy->coords.clear();
 			_proxy->coords.shrink_to_fit();
 
-			_proxy->sphere_vertices.clear();
-			_proxy->sphere_vertices.shrink_to_fit();
-
-			_proxy->sphere_indices.clear();
-			_proxy->sphere_indices.shrink_to_fit();
-
-			_proxy->auxBuffer.clear();
-			_proxy->auxBuffer.shrink_to_fit();
-
 			_proxy->weights.clear();
 			_proxy->weights.shrink_to_fit();
+
+			_proxy->compactWeights.clear();
+			_proxy->compactWeights.shrink_to_fit();
+
+			for (const char* category : { "trajectory", "spline weights" })
+				Memory::release(Memory::CPU, category, std::numeric_limits<size_t>::max());
+			Memory::log();
 			
 			_proxy->isGLloaded = true;
 			_proxy->t = 0.f;
-			Logger::LOG("LOG:\tLoading finished\n\n------------------------------------------------------------------------------------\n", true);
-#if LOG_FRAMES
-			Logger::LOG("[t]\t\t[FPS]\t[1/FPS]", false);
-#endif
+			if (_proxy->config.profile)
+				Profiler::writeReport(_proxy->config.profileReport, _proxy->loadedFile, _proxy->ATOMCOUNT, _proxy->TIMESTEPS);
 		});
 	}
 	
 }
 
+/*
+	Called after the drain that ran the last load task, so the stats include it.
+*/
+void logLoaded(Proxy& _proxy) {
+	const auto stats = _proxy.tasks.statistics();
+	Logger::LOG("LOG:\tGL tasks: " + std::to_string(stats.tasks) + " in " + std::to_string(stats.frames) + " frames, max depth: " + std::to_string(stats.maxDepth)
+		+ ", latency avg/max: " + std::to_string(stats.totalLatencyMs / std::max<size_t>(stats.tasks, 1)) + "/" + std::to_string(stats.maxLatencyMs) + " ms"
+		+ ", longest task: " + std::to_string(stats.maxRunMs) + " ms, over budget: " + std::to_string(stats.overBudget), true);
+	Logger::LOG("LOG:\tLoading finished\n\n------------------------------------------------------------------------------------\n", true);
+	if (_proxy.config.logFrames)
+		Logger::LOG("[t]\t\t[FPS]\t[1/FPS]", false);
+	_proxy.loadReported = true;
+}
+
+/*
+	Runs the cull shader over the centres the compute pass wrote. With occlusion culling
+	_phase 0 appends the atoms visible last frame, _phase 1 tests the rest against the depth
+	pyramid.
+*/
+template<bool OCCLUSION>
+void cull(Proxy& proxy, int _phase) {
+	proxy.cullShader.bind();
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, proxy.cg_vbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, proxy.c_ssbo_visible);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, proxy.g_indirect);
+	//atom occlusion and its visible lists, 0 without atom ao
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, proxy.a_ssbo_ao);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, proxy.c_ssbo_visible_ao);
+
+	Vec4 planes[6];
+	proxy.cam.frustum(planes);
+	glUniform1i(1, proxy.ATOMCOUNT);
+	glUniform4fv(2, 6, glm::value_ptr(planes[0]));
+	glUniform3fv(8, 1, glm::value_ptr(proxy.cam.position));
+	glUniform1f(9, proxy.atomRadius);
+	glUniform1f(10, proxy.cam.projection[1][1] * proxy.wHeight * 0.5f);
+
+	if constexpr (OCCLUSION) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, proxy.c_ssbo_visibility);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_hiz);
+		glUniform1i(11, _phase);
+		glUniformMatrix4fv(12, 1, false, glm::value_ptr(proxy.cam.view));
+		glUniformMatrix4fv(13, 1, false, glm::value_ptr(proxy.cam.projection));
+		glUniform1i(14, 0);
+		glUniform2f(15, static_cast<float>(proxy.wWidth), static_cast<float>(proxy.wHeight));
+	}
+
+	glDispatchCompute((proxy.ATOMCOUNT + 63) / 64, 1, 1);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, 0);
+	if constexpr (OCCLUSION) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	proxy.cullShader.unbind();
+
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+}
+
+//farthest depth pyramid of the g-buffer depth, one dispatch per level
+void buildHiZ(Proxy& proxy) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	proxy.hizShader.bind();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, proxy.g_depth);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, proxy.g_hiz);
+
+	for (int l = 0; l < proxy.hizLevels; ++l) {
+		glUniform1i(1, l);
+		glUniform1i(2, l == 0 ? 0 : 1);
+		glBindImageTexture(0, proxy.g_hiz, l, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		const int w = std::max(1, proxy.wWidth >> l);
+		const int h = std::max(1, proxy.wHeight >> l);
+		glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	proxy.hizShader.unbind();
+}
+
+//the atoms the cull pass appended to the lists of _set, one indirect draw per LOD
+void drawCulled(const Proxy& proxy, uint _set) {
+	const bool impostors = proxy.config.impostors;
+	const size_t stride = impostors ? 4 : 5;
+	const void* offset = reinterpret_cast<const void*>(_set * proxy.LODS * stride * sizeof(uint));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, proxy.g_indirect);
+	if (impostors)
+		glDrawArraysIndirect(GL_TRIANGLE_STRIP, offset);
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, proxy.LODS, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+//the ambient occlusion a frame computes, folded from ssao, ssao-scale, ssao-temporal and atom-ao
+enum class AOMode { none, ssao, scaled, temporal, scaledTemporal, atom };
+
+//how the atoms are culled before the geometry pass, occlusion includes the frustum test
+enum class CullMode { none, frustum, occlusion };
+
+/*
+	One frame of the deferred pipeline. The ao and culling modes add and drop whole passes
+	and are template parameters, selectDraw picks one of the 18 variants once. The widget,
+	impostors and the compact g-buffer only change a few bindings and are read at runtime.
+*/
+template<AOMode AO, CullMode CULL>
+void draw(Proxy& proxy) {
+	constexpr bool SSAO = AO != AOMode::none && AO != AOMode::atom;
+	constexpr bool SSAO_SCALED = AO == AOMode::scaled || AO == AOMode::scaledTemporal;
+	constexpr bool TEMPORAL = AO == AOMode::temporal || AO == AOMode::scaledTemporal;
+	constexpr bool CULLING = CULL != CullMode::none;
+	constexpr bool OCCLUSION = CULL == CullMode::occlusion;
+	const bool impostors = proxy.config.impostors;
+	const bool compact = proxy.config.compactGBuffer;
+
+	// -------------------- Compute Pass --------------------
+	{
+		proxy.compShaders[proxy.interpolation].bind();
+
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+		//buffers
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, proxy.cg_vbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, proxy.c_ssbo_weights);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, proxy.c_ssbo_traj);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, proxy.c_ssbo_motion);
+
+		//uniforms
+		glUniform1i(1, proxy.ATOMCOUNT);
+		glUniform1i(2, proxy.TIMESTEPS);
+		glUniform1f(3, proxy.t);
+		glUniform1f(7, 1.f / proxy.TIMESTEPS);
+		glUniform3fv(8, 1, glm::value_ptr(proxy.dims));
+
+		glDispatchCompute((proxy.ATOMCOUNT + 63) / 64, 1, 1);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, 0);
+
+		proxy.compShaders[proxy.interpolation].unbind();
+
+		//glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+		
+	}
+	// -------------------- Atom AO Pass --------------------
+	if constexpr (AO == AOMode::atom) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, proxy.a_ssbo_count);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, proxy.cg_vbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, proxy.a_ssbo_ao);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, proxy.a_ssbo_count);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, proxy.a_ssbo_start);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, proxy.a_ssbo_cell);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, proxy.a_ssbo_sorted);
+
+		//count, scan (one workgroup), scatter, occlusion
+		for (uint i = 0; i < 4; ++i) {
+			proxy.aoShaders[i].bind();
+			glUniform1i(1, proxy.ATOMCOUNT);
+			glUniform3iv(2, 1, proxy.aoCells);
+			glUniform3fv(3, 1, glm::value_ptr(proxy.aoInvCell));
+			glUniform3fv(4, 1, glm::value_ptr(proxy.dims));
+			glUniform1f(5, proxy.config.atomAORadius);
+			glDispatchCompute(i == 1 ? 1 : (proxy.ATOMCOUNT + 63) / 64, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			proxy.aoShaders[i].unbind();
+		}
+
+		for (GLuint b = 11; b <= 14; ++b)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, 0);
+		//read as instance attribute
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- Cull Pass --------------------
+	if constexpr (CULLING) {
+		//zero the instance counts, the shader appends to them
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, proxy.g_indirect);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, proxy.drawCommands.size() * sizeof(uint), proxy.drawCommands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		cull<OCCLUSION>(proxy, 0);
+	}
+	// -------------------- Geometry Pass --------------------
+	{
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_STENCIL_TEST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.g_fb);
+		glClearColor(0.5f, 0.5f, 0.5f, 1.f);
+		glStencilMask(~0u);
+		glClearDepth(1.f);
+		glClearColor(0.f, 0.f, 0.f, 0.f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+		proxy.geomShader.bind();
+		glBindVertexArray(proxy.g_vao);
+
+		glUniform4fv(9, 1, glm::value_ptr(proxy.atomColor));
+		glUniformMatrix4fv(10, 1, false, glm::value_ptr(proxy.cam.combined));
+		glUniform1f(11, proxy.atomRadius);
+		glStencilMask(0xFF);
+		glStencilFunc(GL_ALWAYS, 1, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+		if (impostors) {
+			glUniformMatrix4fv(12, 1, false, glm::value_ptr(proxy.cam.view));
+			glUniformMatrix4fv(13, 1, false, glm::value_ptr(proxy.cam.projection));
+		}
+		if constexpr (CULLING)
+			//the visible atoms, one draw per LOD with the counts the cull pass left on the gpu
+			drawCulled(proxy, 0);
+		else if (impostors)
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, proxy.ATOMCOUNT);
+		else
+			//one sphere per atom, all in one call
+			glDrawElementsInstanced(GL_TRIANGLES, proxy.INDEXCOUNT, GL_UNSIGNED_INT, (void*)0, proxy.ATOMCOUNT);
+
+		if constexpr (OCCLUSION) {
+			//second phase: what was drawn so far occludes the rest, only the newly visible atoms follow
+			buildHiZ(proxy);
+			cull<true>(proxy, 1);
+			glBindFramebuffer(GL_FRAMEBUFFER, proxy.g_fb);
+			proxy.geomShader.bind();
+			glBindVertexArray(proxy.g_vao);
+			drawCulled(proxy, 1);
+		}
+		
+		glStencilMask(0x00);
+		glStencilFunc(GL_EQUAL, 1, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+		glBindVertexArray(0);
+		proxy.geomShader.unbind();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDisable(GL_DEPTH_TEST);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+	}
+	// -------------------- Copy Depth and Stencil --------------------
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, proxy.g_fb);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, proxy.wWidth, proxy.wHeight, 0, 0, proxy.wWidth, proxy.wHeight, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- SSAO Depth --------------------
+	if constexpr (SSAO_SCALED) {
+		//the reduced passes draw at the size of their targets until the upsample
+		glViewport(0, 0, static_cast<GLsizei>(proxy.s_bounds.x), static_cast<GLsizei>(proxy.s_bounds.y));
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_depth_fb);
+		proxy.ssaoDepthShader.bind();
+		glBindVertexArray(proxy.l_vao);
+
+		glUniform1i(2, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_depth);
+		glUniformMatrix4fv(14, 1, false, glm::value_ptr(glm::inverse(proxy.cam.projection)));
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.ssaoDepthShader.unbind();
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	// -------------------- SSAO --------------------
+	if constexpr (TEMPORAL) {
+		//a new kernel and noise every frame, the history averages them
+		++proxy.s_frame;
+		const std::vector<Vec3> kernel = ssaoKernel(proxy.s_kernelStream, proxy.config.ssaoKernelSize);
+		const std::vector<Vec3> noise = ssaoNoise(proxy.s_noiseStream);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, proxy.s_samples);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, kernel.size() * sizeof(Vec3), kernel.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_rand);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, 4, GL_RGB, GL_FLOAT, noise.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	if constexpr (SSAO) {
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_fb);
+		glClearColor(0.f, 0.f, 0.f, 0.f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		proxy.ssaoShader.bind();
+
+		glBindVertexArray(proxy.l_vao);
+
+		//bind gbuffer
+		glUniform1i(2, 0);
+		glUniform1i(3, 1);
+		glUniform1i(7, 4);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, compact ? proxy.g_depth : proxy.g_pos);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_nrm);
+		if (!compact) {
+			glUniform1i(4, 2);
+			glUniform1i(5, 3);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, proxy.g_t);
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, proxy.g_bt);
+		}
+		if (compact || SSAO_SCALED)
+			glUniformMatrix4fv(14, 1, false, glm::value_ptr(glm::inverse(proxy.cam.projection)));
+		if constexpr (SSAO_SCALED) {
+			glUniform1i(6, 5);
+			glActiveTexture(GL_TEXTURE5);
+			glBindTexture(GL_TEXTURE_2D, proxy.s_depth);
+		}
+
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_rand);
+
+		glUniformMatrix4fv(8, 1, false, glm::value_ptr(proxy.cam.projection));
+		glUniform2fv(9, 1, glm::value_ptr(proxy.s_bounds));
+		glUniform1f(10, proxy.config.ssaoRadius);
+		glUniform1f(11, proxy.config.ssaoBias);
+		glUniformMatrix4fv(12, 1, false, glm::value_ptr(proxy.cam.view));
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, proxy.s_samples);
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.ssaoShader.unbind();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- SSAO Temporal --------------------
+	if constexpr (TEMPORAL) {
+		const uint current = proxy.s_frame & 1;
+		glViewport(0, 0, static_cast<GLsizei>(proxy.s_bounds.x), static_cast<GLsizei>(proxy.s_bounds.y));
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_history_fb[current]);
+		proxy.ssaoTemporalShader.bind();
+		glBindVertexArray(proxy.l_vao);
+
+		glUniform1i(2, 0);
+		glUniform1i(3, 1);
+		glUniform1i(4, 2);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_ssao);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_history[current ^ 1]);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_depth);
+
+		glUniformMatrix4fv(5, 1, false, glm::value_ptr(glm::inverse(proxy.cam.combined)));
+		glUniformMatrix4fv(6, 1, false, glm::value_ptr(proxy.cam.combined));
+		glUniformMatrix4fv(7, 1, false, glm::value_ptr(proxy.s_prevViewProj));
+		proxy.s_prevViewProj = proxy.cam.combined;
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.ssaoTemporalShader.unbind();
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if constexpr (!SSAO_SCALED)
+			glViewport(0, 0, proxy.wWidth, proxy.wHeight);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	//the occlusion the blur starts from
+	const GLuint ssaoResult = TEMPORAL ? proxy.s_history[proxy.s_frame & 1] : proxy.s_ssao;
+	// -------------------- SSAO Bilateral Blur and Upsample --------------------
+	if constexpr (SSAO_SCALED) {
+		proxy.ssaoBilateralShader.bind();
+		glBindVertexArray(proxy.l_vao);
+		glUniform1i(2, 0);
+		glUniform1i(3, 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_depth);
+
+		//horizontal into s_blur, vertical back into s_ssao
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_blur_fb);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, ssaoResult);
+		glUniform2i(4, 1, 0);
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_fb);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_blur);
+		glUniform2i(4, 0, 1);
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		proxy.ssaoBilateralShader.unbind();
+
+		glViewport(0, 0, proxy.wWidth, proxy.wHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.ss_b_fb);
+		proxy.ssaoUpsampleShader.bind();
+
+		glUniform1i(2, 0);
+		glUniform1i(3, 1);
+		glUniform1i(4, 2);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, proxy.s_ssao);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_depth);
+		glUniformMatrix4fv(14, 1, false, glm::value_ptr(glm::inverse(proxy.cam.projection)));
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.ssaoUpsampleShader.unbind();
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- SSAO Blur --------------------
+	else if constexpr (SSAO) {
+		glBindFramebuffer(GL_FRAMEBUFFER, proxy.ss_b_fb);
+		glClearColor(0.f, 0.f, 0.f, 0.f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		proxy.ssaoBlurShader.bind();
+		glBindVertexArray(proxy.l_vao);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, ssaoResult);
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.ssaoBlurShader.unbind();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- Lightning Pass --------------------
+	{
+		proxy.lightShader.bind();
+
+		glBindVertexArray(proxy.l_vao);
+
+		//bind gbuffer
+		glUniform1i(2, 0);
+		glUniform1i(3, 1);
+		glUniform1i(6, 4);
+		if constexpr (SSAO)
+			glUniform1i(7, 5);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, compact ? proxy.g_depth : proxy.g_pos);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_nrm);
+		if (compact)
+			//world position from the depth
+			glUniformMatrix4fv(40, 1, false, glm::value_ptr(glm::inverse(proxy.cam.combined)));
+		else {
+			glUniform1i(4, 2);
+			glUniform1i(5, 3);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, proxy.g_t);
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, proxy.g_bt);
+		}
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_2D, proxy.g_col);
+		if constexpr (SSAO) {
+			glActiveTexture(GL_TEXTURE5);
+			glBindTexture(GL_TEXTURE_2D, proxy.ss_b_tex);
+		}
+
+		//uniforms
+		glUniform3fv(8, 1, glm::value_ptr(proxy.cam.position));
+		glUniform1fv(12, static_cast<GLsizei>(proxy.lights.size()), proxy.lights.data());
+
+		glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+		proxy.lightShader.unbind();
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+	// -------------------- Forward Pass --------------------
+	if (proxy.config.widget) {
+		glDisable(GL_STENCIL_TEST);
+		glEnable(GL_DEPTH_TEST);
+		glClearDepth(1.f);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glViewport(0, 0, proxy.widgetWidth, proxy.widgetHeight);
+
+		glBindVertexArray(proxy.widget_vao);
+		proxy.widgetShader.bind();
+
+		Mat4 rot = glm::lookAt(proxy.cam.position, proxy.cam.position + proxy.cam.direction, proxy.cam.up);
+		proxy.widgetCam.position = rot * Vec4(-1.f, 0.f, 0.f, 1.f) * 5.f;
+		proxy.widgetCam.direction = glm::normalize(-proxy.widgetCam.position);
+		proxy.widgetCam.update();
+
+		glUniform3fv(3, 1, glm::value_ptr(proxy.widgetCam.position));
+		glUniformMatrix4fv(4, 1, false, glm::value_ptr(proxy.widgetCam.combined));
+
+		glDrawElements(GL_TRIANGLES, 420, GL_UNSIGNED_INT, (void*)0);
+
+		proxy.widgetShader.unbind();
+		glBindVertexArray(0);
+	}
+}
+
+template<AOMode AO>
+void (*selectDraw(CullMode _cull))(Proxy&) {
+	switch (_cull) {
+		case CullMode::frustum: return &draw<AO, CullMode::frustum>;
+		case CullMode::occlusion: return &draw<AO, CullMode::occlusion>;
+		default: return &draw<AO, CullMode::none>;
+	}
+}
+
+//Config::validate already dropped the combinations that cannot run (atom-ao with ssao, occlusion without culling)
+void (*selectDraw(const Config& _config))(Proxy&) {
+	const CullMode cull = _config.occlusion ? CullMode::occlusion : _config.culling ? CullMode::frustum : CullMode::none;
+	if (_config.atomAO) return selectDraw<AOMode::atom>(cull);
+	if (!_config.ssao) return selectDraw<AOMode::none>(cull);
+	const bool scaled = _config.ssaoScale > 1;
+	if (_config.ssaoTemporal) return scaled ? selectDraw<AOMode::scaledTemporal>(cull) : selectDraw<AOMode::temporal>(cull);
+	return scaled ? selectDraw<AOMode::scaled>(cull) : selectDraw<AOMode::ssao>(cull);
+}
+
 int main(int argc, char* argv[]) {
 
 	Proxy proxy;
 
-	if (argc >= 2)
-		proxy.pathToFile = std::string(argv[1]);
-
 	Logger::init();
+	Profiler::init();
+
+	if (!proxy.config.parseArgs(argc, argv))
+		return 0;
+	proxy.config.print();
+	ThreadPool::init(proxy.config.threads);
+	proxy.draw = selectDraw(proxy.config);
 	Logger::LOG("\n\n\t\t __  __      _ __      __ _\n\t\t|  \\/  |    | |\\ \\    / /(_)\n\t\t| \\  / |  __| | \\ \\  / /  _  ___\n\t\t| |\\/| | / _` |  \\ \\/ /  | |/ __|\n\t\t| |  | || (_| |   \\  /   | |\\__ \\\n\t\t|_|  |_| \\__,_|    \\/    |_||___/", false);
 	Logger::LOG("heerdam@student.ethz.ch, 2020\n\n------------------------------------------------------------------------------------\n", false);
 
@@ -708,7 +1658,7 @@ int main(int argc, char* argv[]) {
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 	glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
-	proxy.window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "MdVis 0.3a", NULL, NULL);
+	proxy.window = glfwCreateWindow(proxy.config.windowWidth, proxy.config.windowHeight, "MdVis " MDVIS_VERSION, NULL, NULL);
 	if (!proxy.window) {
 		Logger::LOG("ERROR:\tFailed to create window. Shutting down...", true);
 		glfwTerminate();
@@ -723,6 +1673,8 @@ int main(int argc, char* argv[]) {
 	}
 
 	glfwGetFramebufferSize(proxy.window, &proxy.wWidth, &proxy.wHeight);
+	if (proxy.config.gpuBudget == 0)
+		proxy.config.gpuBudget = queryVideoMemory();
 	glViewport(0, 0, proxy.wWidth, proxy.wHeight);
 	glfwSwapInterval(0);
 
@@ -751,7 +1703,6 @@ int main(int argc, char* argv[]) {
 
 	//GLint a, b;
 	//glGetIntegerv(GL_MAX_ELEMENTS_VERTICES, &a);
-	glGetIntegerv(GL_MAX_ELEMENTS_INDICES, &proxy.maxIndices);
 
 	//std::cout << a << std::endl;
 
@@ -782,6 +1733,8 @@ int main(int argc, char* argv[]) {
 			proxy->deltaT = std::clamp(proxy->deltaT -= 0.1f, 0.f, 1.f);
 		if (_key == GLFW_KEY_C && _action == GLFW_PRESS)
 			proxy->deltaT *= -1.f;
+		if (_key == GLFW_KEY_I && _action == GLFW_PRESS)
+			setInterpolation(*proxy, (proxy->requestedInterpolation + 1) % 4);
 		if (proxy->isPaused) {
 			if (_key == GLFW_KEY_X && (_action == GLFW_PRESS || _action == GLFW_REPEAT)) {
 				proxy->t += proxy->deltaT * proxy->deltaTime*100.f;
@@ -820,16 +1773,11 @@ int main(int argc, char* argv[]) {
 	while (!glfwWindowShouldClose(proxy.window) && !proxy.shouldTerminate) {
 
 		double ctime = glfwGetTime();
-
-		if (!proxy.isGLloaded) {
-			{
-				std::lock_guard<std::mutex> lock(proxy.mutex);
-				if (!proxy.asyncQueue.empty()) {
-					proxy.asyncQueue.front()(&proxy);
-					proxy.asyncQueue.pop();
-				}
-			}
-		}
+		//loading, and later the spline weights built on demand, queue their gl work here
+		const bool idle = proxy.tasks.drain(proxy.config.taskBudget, [&proxy](const std::function<void(Proxy*)>& _task) { _task(&proxy); }) == 0
+			&& !proxy.isGLloaded;
+		if (proxy.isGLloaded && !proxy.loadReported)
+			logLoaded(proxy);
 
 		glStencilMask(~0u);
 		glClearDepth(1.f);
@@ -846,230 +1794,7 @@ int main(int argc, char* argv[]) {
 
 			proxy.controller.update(proxy.window, static_cast<float>(proxy.deltaTime));
 
-			// -------------------- Compute Pass --------------------
-			{
-				proxy.compShader.bind();
-
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-
-				//buffers
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, proxy.c_ssbo_sphere);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, proxy.cg_vbo);
-#if INTERPOLATION_TYPE != 3
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, proxy.c_ssbo_weights);
-#endif
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, proxy.c_ssbo_traj);
-
-				//uniforms
-				glUniform1i(1, proxy.ATOMCOUNT);
-				glUniform1i(2, proxy.TIMESTEPS);
-				glUniform1f(3, proxy.t);
-				glUniform1i(4, proxy.SPHEREVERTICES);
-				glUniform1f(5, 0.05f);
-				glUniform4f(6, 0.75f, 0.5f, 0.4f, 1.f);
-				glUniform1f(7, 1.f / proxy.TIMESTEPS);
-				glUniform3fv(8, 1, glm::value_ptr(proxy.dims));
-				glUniform1i(9, ENFORCE_CYCLIC_BOUNDARIES);
-
-				glDispatchCompute(proxy.ATOMCOUNT, 1, 1);
-
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
-
-				proxy.compShader.unbind();
-
-				//glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-
-				
-			}
-			// -------------------- Geometry Pass --------------------
-			{
-				glEnable(GL_DEPTH_TEST);
-				glEnable(GL_STENCIL_TEST);
-
-				glBindFramebuffer(GL_FRAMEBUFFER, proxy.g_fb);
-				glClearColor(0.5f, 0.5f, 0.5f, 1.f);
-				glStencilMask(~0u);
-				glClearDepth(1.f);
-				glClearColor(0.f, 0.f, 0.f, 0.f);
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-				proxy.geomShader.bind();
-				glBindVertexArray(proxy.g_vao);
-
-				glUniform4fv(9, 1, glm::value_ptr(proxy.atomColor));
-				glUniformMatrix4fv(10, 1, false, glm::value_ptr(proxy.cam.combined));
-				glStencilMask(0xFF);
-				glStencilFunc(GL_ALWAYS, 1, 0xFF);
-				glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-				const uint tr = proxy.INDEXCOUNT / 3;
-				const uint mtr = proxy.maxIndices / 3;
-
-				const uint dc = tr / mtr;
-				const uint rest = tr % mtr;
-				
-				for(uint i = 0; i < dc; ++i)
-					glDrawElements(GL_TRIANGLES, mtr*3, GL_UNSIGNED_INT, (void*)(sizeof(uint) * mtr * 3 * i));
-				
-				glDrawElements(GL_TRIANGLES, rest*3, GL_UNSIGNED_INT, (void*)(sizeof(uint) * (proxy.INDEXCOUNT - rest*3)));
-				
-				glStencilMask(0x00);
-				glStencilFunc(GL_EQUAL, 1, 0xFF);
-				glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-
-				glBindVertexArray(0);
-				proxy.geomShader.unbind();
-
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-				glDisable(GL_DEPTH_TEST);
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-	
-			}
-			// -------------------- Copy Depth and Stencil --------------------
-			{
-				glBindFramebuffer(GL_READ_FRAMEBUFFER, proxy.g_fb);
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-				glBlitFramebuffer(0, 0, proxy.wWidth, proxy.wHeight, 0, 0, proxy.wWidth, proxy.wHeight, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-			}
-			// -------------------- SSAO --------------------
-#if USE_SSAO
-			{
-				glBindFramebuffer(GL_FRAMEBUFFER, proxy.s_fb);
-				glClearColor(0.f, 0.f, 0.f, 0.f);
-				glClear(GL_COLOR_BUFFER_BIT);
-				proxy.ssaoShader.bind();
-
-				glBindVertexArray(proxy.l_vao);
-
-				//bind gbuffer
-				glUniform1i(2, 0);
-				glUniform1i(3, 1);
-				glUniform1i(4, 2);
-				glUniform1i(5, 3);
-				glUniform1i(7, 4);
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_pos);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_nrm);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_t);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_bt);
-
-				glActiveTexture(GL_TEXTURE4);
-				glBindTexture(GL_TEXTURE_2D, proxy.s_rand);
-
-				glUniformMatrix4fv(8, 1, false, glm::value_ptr(proxy.cam.projection));
-				glUniform2fv(9, 1, glm::value_ptr(proxy.s_bounds));
-				glUniform1f(10, SSAO_RADIUS);
-				glUniform1f(11, SSAO_BIAS);
-				glUniformMatrix4fv(12, 1, false, glm::value_ptr(proxy.cam.view));
-				glUniform1i(13, SSAO_KERNEL_SIZE);
-
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, proxy.s_samples);
-
-				glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
-
-				glBindVertexArray(0);
-				proxy.ssaoShader.unbind();
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-			}
-			// -------------------- SSAO Blur --------------------
-			{
-				glBindFramebuffer(GL_FRAMEBUFFER, proxy.ss_b_fb);
-				glClearColor(0.f, 0.f, 0.f, 0.f);
-				glClear(GL_COLOR_BUFFER_BIT);
-
-				proxy.ssaoBlurShader.bind();
-				glBindVertexArray(proxy.l_vao);
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, proxy.s_ssao);
-
-				glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
-
-				glBindVertexArray(0);
-				proxy.ssaoBlurShader.unbind();
-
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-			}
-#endif
-			// -------------------- Lightning Pass --------------------
-			{
-				proxy.lightShader.bind();
-
-				glBindVertexArray(proxy.l_vao);
-
-				//bind gbuffer
-				glUniform1i(2, 0);
-				glUniform1i(3, 1);
-				glUniform1i(4, 2);
-				glUniform1i(5, 3);
-				glUniform1i(6, 4);
-#if USE_SSAO
-				glUniform1i(7, 5);
-#endif
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_pos);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_nrm);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_t);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_bt);
-				glActiveTexture(GL_TEXTURE4);
-				glBindTexture(GL_TEXTURE_2D, proxy.g_col);
-#if USE_SSAO
-				glActiveTexture(GL_TEXTURE5);
-				glBindTexture(GL_TEXTURE_2D, proxy.ss_b_tex);
-#endif
-
-				//uniforms
-				glUniform3fv(8, 1, glm::value_ptr(proxy.cam.position));
-				glUniform1fv(12, static_cast<GLsizei>(proxy.lights.size()), proxy.lights.data());
-
-				glDrawElements(GL_TRIANGLES, 6u, GL_UNSIGNED_INT, (void*)0);
-
-				glBindVertexArray(0);
-				proxy.lightShader.unbind();
-				glMemoryBarrier(GL_ALL_BARRIER_BITS);
-			}
-			// -------------------- Forward Pass --------------------
-#if WIDGET_SHOW
-			{
-				glDisable(GL_STENCIL_TEST);
-				glEnable(GL_DEPTH_TEST);
-				glClearDepth(1.f);
-				glClear(GL_DEPTH_BUFFER_BIT);
-				glViewport(0, 0, proxy.widgetWidth, proxy.widgetHeight);
-
-				glBindVertexArray(proxy.widget_vao);
-				proxy.widgetShader.bind();
-
-				Mat4 rot = glm::lookAt(proxy.cam.position, proxy.cam.position + proxy.cam.direction, proxy.cam.up);
-				proxy.widgetCam.position = rot * Vec4(-1.f, 0.f, 0.f, 1.f) * 5.f;
-				proxy.widgetCam.direction = glm::normalize(-proxy.widgetCam.position);
-				proxy.widgetCam.update();
-
-				glUniform3fv(3, 1, glm::value_ptr(proxy.widgetCam.position));
-				glUniformMatrix4fv(4, 1, false, glm::value_ptr(proxy.widgetCam.combined));
-
-				glDrawElements(GL_TRIANGLES, 420, GL_UNSIGNED_INT, (void*)0);
-
-				proxy.widgetShader.unbind();
-				glBindVertexArray(0);
-			}
-#endif
+			proxy.draw(proxy);
 
 			// -------------------- SYNC --------------------
 			//glClientWaitSync(sync[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000); //TODO
@@ -1087,9 +1812,8 @@ int main(int argc, char* argv[]) {
 			frame++;
 
 			if (ctime - time >= 1.0) {
-#if LOG_FRAMES
-				Logger::LOG(std::to_string(proxy.t) + "\t" + std::to_string(frame) + "\t[" + std::to_string(proxy.deltaTime) + "]", true);
-#endif
+				if (proxy.config.logFrames)
+					Logger::LOG(std::to_string(proxy.t) + "\t" + std::to_string(frame) + "\t[" + std::to_string(proxy.deltaTime) + "]", true);
 				frame = 0;
 				time = ctime;
 			}
@@ -1097,8 +1821,12 @@ int main(int argc, char* argv[]) {
 
 		glfwSwapBuffers(proxy.window);
 		proxy.deltaTime = glfwGetTime() - ctime;
+		if (idle)
+			Profiler::idleFrame(proxy.deltaTime * 1000.);
 	}
 	async.join();
+	if (proxy.splineThread.joinable())
+		proxy.splineThread.join();
 	glfwTerminate();
 	return 0;
 }